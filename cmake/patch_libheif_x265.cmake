@@ -0,0 +1,65 @@
+# patch_libheif_x265.cmake – PATCH_COMMAND for the libheif ExternalProject,
+# only applied with -DHEIC_DEMO_X265_ANALYSIS_REUSE=ON
+#
+# libheif's x265 plugin calls x265 encoder_encode() without an output picture.
+# x265 writes the analysis of "x265:analysis-save" through that picture, so the
+# option crashes. This script hands every encoder_encode(..., NULL) call an
+# output picture owned by the plugin, initialised with picture_init() from the
+# encoder's own parameters (encoder_parameters()) before each call, which makes
+# analysis save / load usable for the analysis-reuse HEIC sweep (heic.h).
+#
+# Usage: cmake -DSOURCE_DIR=<libheif source> -P patch_libheif_x265.cmake
+
+set(plugin "${SOURCE_DIR}/libheif/plugins/encoder_x265.cc")
+if(NOT EXISTS "${plugin}")
+  message(FATAL_ERROR "x265 plugin not found: ${plugin}")
+endif()
+
+file(READ "${plugin}" src)
+if(src MATCHES "heif_demo_pic_out")
+  return()  # already patched (the patch step may run again on rebuilds)
+endif()
+
+# Helper right after the x265 include
+string(FIND "${src}" "<x265.h>" include_pos)
+if(include_pos EQUAL -1)
+  string(FIND "${src}" "\"x265.h\"" include_pos)
+endif()
+if(include_pos EQUAL -1)
+  message(FATAL_ERROR "x265.h include not found in ${plugin}")
+endif()
+string(SUBSTRING "${src}" ${include_pos} -1 tail)
+string(FIND "${tail}" "\n" eol)
+math(EXPR split "${include_pos} + ${eol} + 1")
+string(SUBSTRING "${src}" 0 ${split} head)
+string(SUBSTRING "${src}" ${split} -1 tail)
+# (extern "C++": the include may sit inside an extern "C" block)
+set(helper [=[
+// patched (heic_demo): output picture for x265 analysis-save, initialised from
+// the encoder's parameters before every encoder_encode() call
+extern "C++" {
+template <typename Api, typename Encoder>
+static x265_picture* heif_demo_pic_out(Api api, Encoder* encoder)
+{
+  static thread_local x265_picture pic;
+  static thread_local x265_param param;
+  api->encoder_parameters(encoder, &param);
+  api->picture_init(&param, &pic);
+  return &pic;
+}
+}
+]=])
+set(src "${head}${helper}${tail}")
+
+# <api>->encoder_encode(<encoder>, &nals, &num_nals, pic_in, NULL)
+#   -> <api>->encoder_encode(<encoder>, ..., heif_demo_pic_out(<api>, <encoder>))
+set(ws "[ \t\r\n]*")
+set(id "[A-Za-z_][A-Za-z0-9_]*(->[A-Za-z_][A-Za-z0-9_]*|\\.[A-Za-z_][A-Za-z0-9_]*)*")
+string(REGEX REPLACE "(${id})${ws}->${ws}encoder_encode${ws}\\(${ws}(${id})${ws},([^;]*),${ws}NULL${ws}\\)"
+                     "\\1->encoder_encode(\\3,\\5, heif_demo_pic_out(\\1, \\3))" patched "${src}")
+if(patched STREQUAL src)
+  message(FATAL_ERROR "No x265 <api>->encoder_encode(<encoder>, ..., NULL) call found in ${plugin}")
+endif()
+
+file(WRITE "${plugin}" "${patched}")
+message(STATUS "Patched ${plugin}: x265 output picture for analysis-save")
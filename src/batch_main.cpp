@@ -0,0 +1,365 @@
+// batch_main.cpp – headless command line front end for long corpus runs
+//
+//   heic_batch corpus <dir> --log <results.csv | results.rlog>
+//              [--codecs jpeg-dct,heic-ycbcr] [--qualities 0,5,...,100]
+//              [--batch <rows>] [--sync-every <batches>]
+//   heic_batch export <results.rlog> <out.csv>
+//   heic_batch heic-sweep <image> <out.csv> [--qualities 0,5,...,100]
+//              [--shared] [--reuse] [--anchor <q>] [--refine-intra 0..4] [--compare]
+//   heic_batch watch <dir> --out <dir> --log <results.csv | results.rlog>
+//              [--codecs jpeg-dct,heic-ycbcr] [--qualities 50,80] [--queue <items>]
+//              [--encoders <threads>] [--stats-every <seconds>] [--no-existing]
+//   heic_batch calibrate [<results.csv | results.rlog>...]
+//              [--sweep <codec> <image> <sweep.csv>]... --model <model.csv>
+//   heic_batch predict <image> --model <model.csv> --target <dB> --out <file>
+//              [--codec jpeg-dct|heic-ycbcr|jpeg-tj|heic-rgb] [--no-correct]
+//
+// Codec names are encoder paths (see corpus_sweep.h / quality_predictor.h):
+// "jpeg-dct" / "heic-ycbcr" are the corpus and watch encoders, "jpeg-tj" /
+// "heic-rgb" the classic JPEG and HEIC sweeps. A sweep CSV calibrates the
+// path it came from.
+//
+// Rerunning "corpus" with the same log resumes where the last run stopped.
+// "watch" runs until SIGINT / SIGTERM and then finishes the queued images.
+
+#include "corpus_sweep.h"
+#include "quality_predictor.h"
+#include "results_log.h"
+#include "watch_daemon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> split_list(const std::string& s)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, ',');)
+        if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+static int usage()
+{
+    std::cerr << "Usage:\n"
+              << "  heic_batch corpus <dir> --log <results.csv|results.rlog> [--codecs jpeg-dct,heic-ycbcr]\n"
+              << "                    [--qualities 0,5,...,100] [--batch <rows>] [--sync-every <batches>]\n"
+              << "  heic_batch export <results.rlog> <out.csv>\n"
+              << "  heic_batch heic-sweep <image> <out.csv> [--qualities 0,5,...,100] [--shared] [--reuse]\n"
+              << "                        [--anchor <q>] [--refine-intra 0..4] [--compare]\n"
+              << "  heic_batch watch <dir> --out <dir> --log <results.csv|results.rlog>\n"
+              << "                   [--codecs jpeg-dct,heic-ycbcr]\n"
+              << "                   [--qualities 50,80] [--queue <items>] [--encoders <threads>]\n"
+              << "                   [--stats-every <seconds>] [--no-existing]\n"
+              << "  heic_batch calibrate [<results.csv|results.rlog>...]\n"
+              << "                       [--sweep <codec> <image> <sweep.csv>]... --model <model.csv>\n"
+              << "  heic_batch predict <image> --model <model.csv> --target <dB> --out <file>\n"
+              << "                     [--codec jpeg-dct|heic-ycbcr|jpeg-tj|heic-rgb] [--no-correct]\n";
+    return 2;
+}
+
+static int run_corpus(int argc, char** argv)
+{
+    if (argc < 3) return usage();
+    const std::string dir = argv[2];
+    std::string log_path;
+    std::vector<std::string> codecs = {"jpeg-dct", "heic-ycbcr"};
+    std::vector<int> qualities = {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100};
+    ResultsLogOptions opts;
+
+    for (int i = 3; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg != "--log" && arg != "--codecs" && arg != "--batch" && arg != "--sync-every" &&
+            arg != "--qualities") {
+            std::cerr << "Unknown argument " << arg << '\n';
+            return 2;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << '\n';
+            return 2;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--log")             log_path = value;
+        else if (arg == "--codecs")     codecs = split_list(value);
+        else if (arg == "--batch")      opts.batch_rows = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--sync-every") opts.sync_every = std::atoi(value.c_str());
+        else {
+            qualities.clear();
+            for (const std::string& q : split_list(value)) qualities.push_back(std::atoi(q.c_str()));
+        }
+    }
+    if (log_path.empty()) return usage();
+    for (const std::string& codec : codecs)
+        if (!isCorpusCodec(codec)) {
+            std::cerr << "Unknown codec " << codec << " (jpeg-dct, heic-ycbcr)\n";
+            return 2;
+        }
+
+    const std::vector<std::string> images = listCorpusImages(dir);
+    try {
+        ResultsLog log(log_path, ResultsLog::formatForPath(log_path), opts);
+        if (log.resumedRows())
+            std::cout << "(CORPUS) Resuming " << log_path << " with " << log.resumedRows() << " rows\n";
+        if (log.skippedLines())
+            std::cerr << "(CORPUS) Skipped " << log.skippedLines() << " unreadable lines in " << log_path << '\n';
+        const size_t appended = runCorpusSweep(images, codecs, log, qualities);
+        std::cout << "(CORPUS) " << images.size() << " images, " << appended << " rows appended to "
+                  << log_path << '\n';
+    } catch (const std::exception& e) {
+        std::cerr << "(CORPUS) " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+static int run_export(int argc, char** argv)
+{
+    if (argc != 4) return usage();
+    std::vector<ResultsRow> rows;
+    if (!ResultsLog::readAll(argv[2], ResultsLog::formatForPath(argv[2]), rows)) {
+        std::cerr << "Cannot read " << argv[2] << '\n';
+        return 1;
+    }
+    try {
+        std::filesystem::remove(argv[3]);   // export overwrites, it never resumes
+        ResultsLog out(argv[3], ResultsFormat::CSV, {rows.size() + 1, 0});
+        for (ResultsRow& r : rows) out.append(std::move(r));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Single-image HEIC sweep. --shared uses evaluateHeicSharedSourceSweep,
+// --reuse (implies --shared) adds x265 analysis reuse, --compare (implies
+// --shared) adds the independent encodes, their deviation and the speedup to
+// the CSV / output.
+static int run_heic_sweep(int argc, char** argv)
+{
+    if (argc < 4) return usage();
+    const std::string image = argv[2], csv = argv[3];
+    std::vector<int> qualities = {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100};
+    bool shared = false, compare = false;
+    HeicAnalysisReuse reuse;
+
+    for (int i = 4; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool takes_value = arg == "--anchor" || arg == "--refine-intra" || arg == "--qualities";
+        if (arg == "--shared")       shared = true;
+        else if (arg == "--compare") shared = compare = true;
+        else if (arg == "--reuse")   shared = reuse.enabled = true;
+        else if (!takes_value) {
+            std::cerr << "Unknown argument " << arg << '\n';
+            return 2;
+        } else if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << '\n';
+            return 2;
+        }
+        else if (arg == "--anchor")       reuse.anchor_quality = std::atoi(argv[++i]);
+        else if (arg == "--refine-intra") reuse.refine_intra = std::clamp(std::atoi(argv[++i]), 0, 4);
+        else {
+            qualities.clear();
+            for (const std::string& q : split_list(argv[++i])) qualities.push_back(std::atoi(q.c_str()));
+        }
+    }
+
+    const bool ok = shared ? evaluateHeicSharedSourceSweep(image, csv, false, qualities, compare, {}, reuse)
+                           : evaluateHeicQualitySweep(image, csv, false, qualities);
+    return ok ? 0 : 1;
+}
+
+static std::atomic<bool> g_stop{false};
+
+static void on_signal(int) { g_stop = true; }
+
+static int run_watch(int argc, char** argv)
+{
+    if (argc < 3) return usage();
+    WatchOptions opts;
+    opts.watch_dir = argv[2];
+    int stats_every = 10;
+
+    for (int i = 3; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--no-existing") {
+            opts.process_existing = false;
+            continue;
+        }
+        if (arg != "--out" && arg != "--log" && arg != "--codecs" && arg != "--queue" && arg != "--encoders" &&
+            arg != "--stats-every" && arg != "--qualities") {
+            std::cerr << "Unknown argument " << arg << '\n';
+            return 2;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << '\n';
+            return 2;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--out")              opts.output_dir = value;
+        else if (arg == "--log")         opts.log_path = value;
+        else if (arg == "--codecs")      opts.codecs = split_list(value);
+        else if (arg == "--queue")       opts.queue_capacity = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--encoders")    opts.encode_threads = std::atoi(value.c_str());
+        else if (arg == "--stats-every") stats_every = std::max(1, std::atoi(value.c_str()));
+        else {
+            opts.qualities.clear();
+            for (const std::string& q : split_list(value)) opts.qualities.push_back(std::atoi(q.c_str()));
+        }
+    }
+    if (opts.output_dir.empty() || opts.log_path.empty()) return usage();
+    for (const std::string& codec : opts.codecs)
+        if (!isCorpusCodec(codec)) {
+            std::cerr << "Unknown codec " << codec << " (jpeg-dct, heic-ycbcr)\n";
+            return 2;
+        }
+
+    try {
+        WatchDaemon daemon(opts);
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        if (!daemon.start()) return 1;
+        std::cout << "(WATCH) Watching " << opts.watch_dir << ", Ctrl+C to stop" << std::endl;
+
+        auto next_stats = std::chrono::steady_clock::now() + std::chrono::seconds(stats_every);
+        while (!g_stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            if (std::chrono::steady_clock::now() >= next_stats) {
+                std::cout << "(WATCH) " << daemon.stats() << std::endl;
+                next_stats += std::chrono::seconds(stats_every);
+            }
+        }
+
+        std::cout << "(WATCH) Stopping, finishing queued images..." << std::endl;
+        daemon.stop();
+        daemon.wait();
+        std::cout << "(WATCH) " << daemon.stats() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "(WATCH) " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+static int run_calibrate(int argc, char** argv)
+{
+    struct SweepInput { std::string codec, image, csv; };
+    std::vector<std::string> logs;
+    std::vector<SweepInput> sweeps;
+    std::string model_path;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--model" && i + 1 < argc) model_path = argv[++i];
+        else if (arg == "--sweep") {
+            if (i + 3 >= argc) {
+                std::cerr << "--sweep needs <codec> <image> <sweep.csv>\n";
+                return 2;
+            }
+            SweepInput in{argv[i + 1], argv[i + 2], argv[i + 3]};
+            i += 3;
+            if (!isPredictorCodec(in.codec)) {
+                std::cerr << "Unknown codec " << in.codec << " (jpeg-dct, heic-ycbcr, jpeg-tj, heic-rgb)\n";
+                return 2;
+            }
+            sweeps.push_back(in);
+        } else logs.push_back(arg);
+    }
+    if ((logs.empty() && sweeps.empty()) || model_path.empty()) return usage();
+
+    QualityPredictor model;
+    size_t samples = 0;
+    for (const std::string& log : logs) {
+        const size_t n = model.addResultsLog(log);
+        if (n == 0) std::cerr << "(PREDICT) No samples from " << log << '\n';
+        samples += n;
+    }
+    for (const SweepInput& in : sweeps) {
+        const size_t n = model.addSweepCSV(in.image, in.csv, in.codec);
+        if (n == 0) std::cerr << "(PREDICT) No samples from " << in.csv << " / " << in.image << '\n';
+        samples += n;
+    }
+    if (samples == 0) {
+        std::cerr << "No calibration samples, model not written\n";
+        return 1;
+    }
+    model.fit();
+    const std::vector<std::string> codecs = model.codecs();
+    if (codecs.empty()) {
+        std::cerr << "No quality level has samples from 5 or more images, model not written\n";
+        return 1;
+    }
+    if (!model.save(model_path)) {
+        std::cerr << "Cannot write " << model_path << '\n';
+        return 1;
+    }
+    std::cout << "(PREDICT) Calibrated on " << samples << " samples (";
+    for (size_t i = 0; i < codecs.size(); ++i) std::cout << (i ? ", " : "") << codecs[i];
+    std::cout << "), model written to " << model_path << '\n';
+    return 0;
+}
+
+static int run_predict(int argc, char** argv)
+{
+    if (argc < 3) return usage();
+    const std::string image = argv[2];
+    std::string model_path, out_path, codec = "jpeg-dct";
+    double target = 0.0;
+    bool correct = true;
+    for (int i = 3; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--no-correct") {
+            correct = false;
+            continue;
+        }
+        if (arg != "--model" && arg != "--out" && arg != "--codec" && arg != "--target") {
+            std::cerr << "Unknown argument " << arg << '\n';
+            return 2;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << '\n';
+            return 2;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--model")       model_path = value;
+        else if (arg == "--out")    out_path = value;
+        else if (arg == "--codec")  codec = value;
+        else                        target = std::atof(value.c_str());
+    }
+    if (model_path.empty() || out_path.empty() || target <= 0.0) return usage();
+
+    QualityPredictor model;
+    if (!model.load(model_path) || !model.hasModel(codec)) {
+        std::cerr << "No " << codec << " model in " << model_path << '\n';
+        return 1;
+    }
+    const PredictedEncodeResult r = encodeAtTarget(image, out_path, model, codec, target, correct);
+    if (r.encodes == 0 || std::isnan(r.psnr)) {
+        std::cerr << "Encoding failed\n";
+        return 1;
+    }
+    std::cout << "(PREDICT) predicted q" << r.predicted_quality << ", kept q" << r.quality << ": "
+              << r.psnr << " dB, " << r.size_bytes << " bytes, " << r.encodes << " encode(s)\n";
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) return usage();
+    const std::string cmd = argv[1];
+    if (cmd == "corpus") return run_corpus(argc, argv);
+    if (cmd == "export") return run_export(argc, argv);
+    if (cmd == "heic-sweep") return run_heic_sweep(argc, argv);
+    if (cmd == "watch")  return run_watch(argc, argv);
+    if (cmd == "calibrate") return run_calibrate(argc, argv);
+    if (cmd == "predict")   return run_predict(argc, argv);
+    return usage();
+}
@@ -0,0 +1,236 @@
+// colorconv.h – header‑only RGB → YCbCr conversion with chroma downsampling (SSE2 + threads)
+
+#ifndef COLORCONV_H
+#define COLORCONV_H
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLORCONV_SSE2 1
+#endif
+
+// ----------------------------------------------------------------------------
+// Conversion settings
+// ----------------------------------------------------------------------------
+enum class ChromaFormat { C420, C422, C444 };
+enum class YCbCrMatrix { BT601, BT709 };
+
+// Horizontal position of a subsampled chroma sample. Center averages the two
+// luma columns it covers (HEVC chroma_sample_loc_type 1, JPEG / JFIF); Left
+// is co‑sited with the even luma column and filtered [1 2 1] / 4 (type 0,
+// the HEVC / H.264 default). Vertically 4:2:0 chroma is always centred.
+enum class ChromaSiting { Center, Left };
+
+// Size of a chroma plane for the given luma size
+inline int chroma_width(ChromaFormat f, int w)  { return f == ChromaFormat::C444 ? w : (w + 1) / 2; }
+inline int chroma_height(ChromaFormat f, int h) { return f == ChromaFormat::C420 ? (h + 1) / 2 : h; }
+
+// Destination planes (8 bit each), strides in bytes
+struct YCbCrPlanes {
+    uint8_t* y;  int y_stride;
+    uint8_t* cb; int cb_stride;
+    uint8_t* cr; int cr_stride;
+};
+
+namespace colorconv_detail {
+
+constexpr int kShift = 14;  // fixed‑point precision of the coefficients
+
+// One output row: out = clamp((r*R + g*G + b*B + offset) >> kShift)
+struct Coeffs {
+    int16_t r, g, b;
+    int32_t offset;
+};
+
+struct Matrix {
+    Coeffs y, cb, cr;
+};
+
+inline int16_t fixed(double v) { return static_cast<int16_t>(v * (1 << kShift) + (v < 0 ? -0.5 : 0.5)); }
+
+// Build the integer matrix. The G coefficient absorbs the rounding error so
+// that grey input maps exactly to Y = grey and Cb = Cr = 128.
+inline Matrix make_matrix(YCbCrMatrix m, bool full_range)
+{
+    const double kr = m == YCbCrMatrix::BT709 ? 0.2126 : 0.299;
+    const double kb = m == YCbCrMatrix::BT709 ? 0.0722 : 0.114;
+    const double ys = full_range ? 1.0 : 219.0 / 255.0;
+    const double cs = full_range ? 1.0 : 224.0 / 255.0;
+    const int32_t round = 1 << (kShift - 1);
+
+    Matrix out{};
+    out.y.r = fixed(kr * ys);
+    out.y.b = fixed(kb * ys);
+    out.y.g = static_cast<int16_t>(fixed(ys) - out.y.r - out.y.b);
+    out.y.offset = ((full_range ? 0 : 16) << kShift) + round;
+
+    out.cb.r = fixed(-kr / (2.0 * (1.0 - kb)) * cs);
+    out.cb.b = fixed(0.5 * cs);
+    out.cb.g = static_cast<int16_t>(-out.cb.r - out.cb.b);
+    out.cb.offset = (128 << kShift) + round;
+
+    out.cr.r = fixed(0.5 * cs);
+    out.cr.b = fixed(-kb / (2.0 * (1.0 - kr)) * cs);
+    out.cr.g = static_cast<int16_t>(-out.cr.r - out.cr.b);
+    out.cr.offset = (128 << kShift) + round;
+    return out;
+}
+
+inline uint8_t clamp_u8(int32_t v) { return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+// Apply one matrix row to n planar samples
+inline void apply_row(const int16_t* r, const int16_t* g, const int16_t* b, int n,
+                      const Coeffs& c, uint8_t* out)
+{
+    int i = 0;
+#ifdef COLORCONV_SSE2
+    // (R,G) pairs and (B,0) pairs go through pmaddwd, giving exact 32‑bit sums
+    const __m128i crg = _mm_set1_epi32(static_cast<int32_t>(
+        (static_cast<uint32_t>(static_cast<uint16_t>(c.g)) << 16) | static_cast<uint16_t>(c.r)));
+    const __m128i cb0 = _mm_set1_epi32(static_cast<uint16_t>(c.b));
+    const __m128i off = _mm_set1_epi32(c.offset);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        const __m128i vr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        const __m128i vg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + i));
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(vr, vg), crg),
+                                   _mm_madd_epi16(_mm_unpacklo_epi16(vb, zero), cb0));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(vr, vg), crg),
+                                   _mm_madd_epi16(_mm_unpackhi_epi16(vb, zero), cb0));
+        lo = _mm_srai_epi32(_mm_add_epi32(lo, off), kShift);
+        hi = _mm_srai_epi32(_mm_add_epi32(hi, off), kShift);
+
+        const __m128i packed = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(packed, packed));
+    }
+#endif
+    for (; i < n; ++i)
+        out[i] = clamp_u8((c.r * r[i] + c.g * g[i] + c.b * b[i] + c.offset) >> kShift);
+}
+
+// Scratch rows for one worker
+struct RowBuffers {
+    std::vector<int16_t> r[2], g[2], b[2];  // two full‑width source rows
+    std::vector<int16_t> dr, dg, db;        // downsampled chroma input
+
+    explicit RowBuffers(int w)
+        : dr(w), dg(w), db(w)
+    {
+        for (int k = 0; k < 2; ++k) { r[k].resize(w); g[k].resize(w); b[k].resize(w); }
+    }
+};
+
+inline void deinterleave(const uint8_t* src, int w, int16_t* r, int16_t* g, int16_t* b)
+{
+    for (int x = 0; x < w; ++x) {
+        r[x] = src[x * 3 + 0];
+        g[x] = src[x * 3 + 1];
+        b[x] = src[x * 3 + 2];
+    }
+}
+
+// Filter 2×1 (a1 == a0) or 2×2 rows into the chroma input, or copy for 4:4:4.
+// Columns outside the image are replicated from the border.
+inline void downsample(const int16_t* a0, const int16_t* a1, int w, bool horizontal,
+                       ChromaSiting siting, int16_t* out)
+{
+    if (!horizontal) {
+        std::copy(a0, a0 + w, out);
+        return;
+    }
+    const int cw = (w + 1) / 2;
+    if (siting == ChromaSiting::Left) {
+        for (int x = 0; x < cw; ++x) {
+            const int x0 = 2 * x;
+            const int xl = std::max(x0 - 1, 0);
+            const int xr = std::min(x0 + 1, w - 1);
+            out[x] = static_cast<int16_t>((a0[xl] + 2 * a0[x0] + a0[xr] +
+                                           a1[xl] + 2 * a1[x0] + a1[xr] + 4) >> 3);
+        }
+        return;
+    }
+    for (int x = 0; x < cw; ++x) {
+        const int x0 = 2 * x;
+        const int x1 = std::min(x0 + 1, w - 1);
+        out[x] = static_cast<int16_t>((a0[x0] + a0[x1] + a1[x0] + a1[x1] + 2) >> 2);
+    }
+}
+
+} // namespace colorconv_detail
+
+// ----------------------------------------------------------------------------
+// Convert interleaved 8‑bit RGB to planar YCbCr
+// Rows are processed in pairs so 4:2:0 chroma can be produced in the same pass;
+// the image is split into horizontal bands, one per thread (0 = all cores).
+// ----------------------------------------------------------------------------
+inline void rgbToYCbCr(const uint8_t* rgb, int width, int height, int rgb_stride,
+                       const YCbCrPlanes& out, ChromaFormat format,
+                       YCbCrMatrix matrix = YCbCrMatrix::BT601, bool full_range = true,
+                       int threads = 0, ChromaSiting siting = ChromaSiting::Center)
+{
+    using namespace colorconv_detail;
+    if (width <= 0 || height <= 0) return;
+
+    const Matrix m = make_matrix(matrix, full_range);
+    const bool sub_h = format != ChromaFormat::C444;
+    const bool sub_v = format == ChromaFormat::C420;
+    const int cw = chroma_width(format, width);
+
+    auto convert_rows = [&](int row_begin, int row_end) {
+        RowBuffers buf(width);
+        for (int y = row_begin; y < row_end; y += 2) {
+            const int rows = std::min(2, height - y);
+            for (int k = 0; k < rows; ++k) {
+                deinterleave(rgb + size_t(y + k) * rgb_stride, width,
+                             buf.r[k].data(), buf.g[k].data(), buf.b[k].data());
+                apply_row(buf.r[k].data(), buf.g[k].data(), buf.b[k].data(), width,
+                          m.y, out.y + size_t(y + k) * out.y_stride);
+            }
+
+            // Chroma rows produced from this pair: one for 4:2:0, otherwise one per source row
+            const int chroma_rows = sub_v ? 1 : rows;
+            for (int k = 0; k < chroma_rows; ++k) {
+                const int k0 = sub_v ? 0 : k;
+                const int k1 = sub_v ? (rows == 2 ? 1 : 0) : k;
+                downsample(buf.r[k0].data(), buf.r[k1].data(), width, sub_h, siting, buf.dr.data());
+                downsample(buf.g[k0].data(), buf.g[k1].data(), width, sub_h, siting, buf.dg.data());
+                downsample(buf.b[k0].data(), buf.b[k1].data(), width, sub_h, siting, buf.db.data());
+
+                const int cy = sub_v ? y / 2 : y + k;
+                apply_row(buf.dr.data(), buf.dg.data(), buf.db.data(), cw, m.cb,
+                          out.cb + size_t(cy) * out.cb_stride);
+                apply_row(buf.dr.data(), buf.dg.data(), buf.db.data(), cw, m.cr,
+                          out.cr + size_t(cy) * out.cr_stride);
+            }
+        }
+    };
+
+    // Bands of at least 32 row pairs so small images stay single‑threaded
+    const int pairs = (height + 1) / 2;
+    int n_threads = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+    n_threads = std::max(1, std::min(n_threads, pairs / 32));
+
+    if (n_threads == 1) {
+        convert_rows(0, height);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(n_threads);
+    const int pairs_per_thread = (pairs + n_threads - 1) / n_threads;
+    for (int t = 0; t < n_threads; ++t) {
+        const int begin = t * pairs_per_thread * 2;
+        const int end = std::min(height, begin + pairs_per_thread * 2);
+        if (begin >= end) break;
+        workers.emplace_back(convert_rows, begin, end);
+    }
+    for (std::thread& th : workers) th.join();
+}
+
+#endif // COLORCONV_H
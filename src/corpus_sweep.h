@@ -0,0 +1,138 @@
+// corpus_sweep.h – header‑only quality sweep over a whole image corpus,
+// streamed into a ResultsLog and resumable after an interruption
+
+#ifndef CORPUS_SWEEP_H
+#define CORPUS_SWEEP_H
+
+#include "heic.h"                // HeicEncoder::make_ycbcr_image / encode_to_memory, HeicDecoder
+#include "jpg_sweep.h"           // JpegDctSweep, JpgEncoder (alpha mask), JpgDecoder
+#include "results_log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// Images are recognised by extension. listCorpusImages returns those below
+// dir (recursive), sorted so reruns visit them in the same order.
+// ----------------------------------------------------------------------------
+inline bool isCorpusImage(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tga";
+}
+
+inline std::vector<std::string> listCorpusImages(const std::string& dir)
+{
+    std::vector<std::string> images;
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+        if (it->is_regular_file() && isCorpusImage(it->path()))
+            images.push_back(it->path().string());
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+// ----------------------------------------------------------------------------
+// Codecs of corpus and watch rows. They are not the encoders of the classic
+// sweeps (tjCompress2 in JpegPSNRtoCSV, libheif's RGB conversion in
+// evaluateHeicQualitySweep), so they carry their own names and their rows are
+// never mixed with results of those:
+//   "jpeg-dct"    JpegDctSweep (float DCT once per image), alpha mask like
+//                 JpegPSNRtoCSV
+//   "heic-ycbcr"  own YCbCr 4:2:0 conversion once per image, like
+//                 evaluateHeicSharedSourceSweep
+// ----------------------------------------------------------------------------
+inline bool isCorpusCodec(const std::string& codec) { return codec == "jpeg-dct" || codec == "heic-ycbcr"; }
+
+// ----------------------------------------------------------------------------
+// Sweep every image with the given codecs (see isCorpusCodec) and append one
+// row per point to log.
+// Points already in the log are skipped, images without missing points are
+// not even loaded. Returns the number of rows appended.
+// ----------------------------------------------------------------------------
+inline size_t runCorpusSweep(const std::vector<std::string>& images,
+                             const std::vector<std::string>& codecs,
+                             ResultsLog& log,
+                             const std::vector<int>& qualities = {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100})
+{
+    size_t appended = 0;
+    std::vector<unsigned char> jpeg;
+    std::vector<uint8_t> heic, decoded;
+
+    for (size_t i = 0; i < images.size(); ++i) {
+        const std::string& image = images[i];
+
+        for (const std::string& codec : codecs) {
+            std::vector<int> todo;
+            for (int q : qualities)
+                if (!log.contains(image, codec, q)) todo.push_back(q);
+            if (todo.empty()) continue;
+
+            if (codec == "jpeg-dct") {
+                std::unique_ptr<JpgEncoder> reference;
+                try {
+                    reference = std::make_unique<JpgEncoder>(image.c_str(), "dummy.jpg");  // output file unused
+                } catch (...) {
+                    std::cerr << "(CORPUS) Could not load " << image << '\n';
+                    continue;
+                }
+                reference->applyAlphaMask();
+                const int w = reference->getWidth(), h = reference->getHeight();
+                const JpegDctSweep sweep(reference->getData(), w, h);
+
+                for (int q : todo) {
+                    JpgDecoder dec("", "unused.png");
+                    if (!sweep.encode(q, jpeg) ||
+                        !dec.jpeg_decompress_buffer(jpeg.data(), static_cast<unsigned long>(jpeg.size()))) {
+                        std::cerr << "(CORPUS) JPEG failed at quality=" << q << " for " << image << '\n';
+                        continue;
+                    }
+                    log.append({image, codec, q, computePSNR(reference->getData(), dec.getRGBData(), w, h), jpeg.size()});
+                    ++appended;
+                }
+            } else if (codec == "heic-ycbcr") {
+                int w, h, comp;
+                unsigned char* reference = stbi_load(image.c_str(), &w, &h, &comp, 3);
+                if (!reference) {
+                    std::cerr << "(CORPUS) Could not load " << image << '\n';
+                    continue;
+                }
+                const HeicYCbCrOptions ycbcr;
+                heif_image* source = HeicEncoder::make_ycbcr_image(reference, w, h, ycbcr);
+
+                for (int q : todo) {
+                    int dec_w = 0, dec_h = 0;
+                    if (!source ||
+                        !HeicEncoder::encode_to_memory(source, q, heic, HeicEncoder::chroma_param(ycbcr.chroma),
+                                                       HeicEncoder::ycbcr_params(ycbcr)) ||
+                        !HeicDecoder::decode_memory_to_rgb(heic.data(), heic.size(), decoded, dec_w, dec_h) ||
+                        dec_w != w || dec_h != h) {
+                        std::cerr << "(CORPUS) HEIC failed at quality=" << q << " for " << image << '\n';
+                        continue;
+                    }
+                    log.append({image, codec, q, computePSNR(reference, decoded.data(), w, h), heic.size()});
+                    ++appended;
+                }
+
+                if (source) heif_image_release(source);
+                stbi_image_free(reference);
+            } else {
+                std::cerr << "(CORPUS) Unknown codec " << codec << '\n';
+            }
+        }
+
+        if ((i + 1) % 100 == 0)
+            std::cout << "(CORPUS) " << i + 1 << '/' << images.size() << " images\n";
+    }
+
+    log.flush(true);
+    return appended;
+}
+
+#endif // CORPUS_SWEEP_H
@@ -4,6 +4,8 @@
 
 #include "heic.h"
 #include "jpg.h"
+#include "heatmap.h"
+#include "jpg_sweep.h"
 
 #include <GLFW/glfw3.h>
 
@@ -16,6 +18,11 @@
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <cctype>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <future>
 
 // ---------------------------------------------------------------------------
 static void glfw_error_callback(int error, const char *desc)
@@ -32,6 +39,95 @@ static std::string change_extension(const char *path, const char *new_ext)
     return p.string();
 }
 
+// ---------------------------------------------------------------------------
+// Utility: load HEIC, JPEG or any stb_image format as interleaved RGB
+static bool load_rgb_any(const std::string &path, std::vector<uint8_t> &rgb, int &w, int &h)
+{
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    if (ext == ".heic" || ext == ".heif")
+        return HeicDecoder(path).decode_to_rgb(rgb, w, h);
+
+    if (ext == ".jpg" || ext == ".jpeg")
+    {
+        JpgDecoder dec(path.c_str(), "");
+        if (!dec.jpeg_decompress())
+            return false;
+        w = dec.getWidth();
+        h = dec.getHeight();
+        rgb.assign(dec.getRGBData(), dec.getRGBData() + size_t(w) * h * 3);
+        return true;
+    }
+
+    int comp = 0;
+    unsigned char *data = stbi_load(path.c_str(), &w, &h, &comp, 3);
+    if (!data)
+        return false;
+    rgb.assign(data, data + size_t(w) * h * 3);
+    stbi_image_free(data);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Error heatmap: computed off the UI thread, uploaded as two textures
+// (downscaled reference preview + one texel per tile overlay)
+struct HeatmapJob
+{
+    bool ok = false;
+    std::string error;
+    ErrorHeatmap map;
+    std::vector<uint8_t> preview; // RGB, at most 2048 px on the long side
+    int preview_w = 0;
+    int preview_h = 0;
+    double seconds = 0.0;
+};
+
+static HeatmapJob run_heatmap_job(std::string ref_path, std::string cmp_path, int tile)
+{
+    HeatmapJob job;
+    std::vector<uint8_t> ref, cmp;
+    int rw = 0, rh = 0, cw = 0, ch = 0;
+    if (!load_rgb_any(ref_path, ref, rw, rh) || !load_rgb_any(cmp_path, cmp, cw, ch))
+    {
+        job.error = "could not load images";
+        return job;
+    }
+    if (rw != cw || rh != ch)
+    {
+        job.error = "image sizes differ";
+        return job;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    job.map = computeErrorHeatmap(ref.data(), cmp.data(), rw, rh, tile);
+    job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // Nearest‑neighbour preview keeps 100 MP inputs within texture limits
+    const int step = std::max(1, (std::max(rw, rh) + 2047) / 2048);
+    job.preview_w = (rw + step - 1) / step;
+    job.preview_h = (rh + step - 1) / step;
+    job.preview.resize(size_t(job.preview_w) * job.preview_h * 3);
+    for (int y = 0; y < job.preview_h; ++y)
+        for (int x = 0; x < job.preview_w; ++x)
+            std::memcpy(&job.preview[(size_t(y) * job.preview_w + x) * 3],
+                        &ref[(size_t(y) * step * rw + size_t(x) * step) * 3], 3);
+
+    job.ok = true;
+    return job;
+}
+
+static void upload_texture(GLuint &tex, const uint8_t *pixels, int w, int h, GLenum format)
+{
+    if (!tex)
+        glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, pixels);
+}
+
 // ---------------------------------------------------------------------------
 inline int run_gui()
 {
@@ -64,6 +160,10 @@ inline int run_gui()
     bool heic_encode = true;
     bool heic_done_ok = false;
     bool heic_show_msg = false; // whether to show the green banner
+    int heic_colour_path = 0;   // 0 = RGB via libheif, 1..3 = own YCbCr 4:2:0 / 4:2:2 / 4:4:4
+    bool heic_bt709 = false;
+    bool heic_full_range = true;
+    bool heic_left_siting = false; // co-sited chroma instead of centred (4:2:0 / 4:2:2)
 
     // JPEG
     char jpg_in[512] = "";
@@ -79,9 +179,31 @@ inline int run_gui()
     bool psnr_is_jpeg = true;
     bool psnr_done_ok = false;
     bool keep_tmp_files = false;
+    bool psnr_dct_once = false; // JPEG: colour conversion + DCT once per image (opt-in, float DCT)
+    bool psnr_estimate = false; // JPEG: DCT‑domain PSNR estimate instead of encoding
+    bool psnr_verify = false;   // JPEG estimate: also decode every point and report the deviation
+    bool psnr_shared_src = false; // HEIC: load + colour conversion once per image (opt-in, own YCbCr)
+    bool psnr_compare = false;    // HEIC shared source: also run independent encodes and report deviation
+    bool psnr_reuse = false;      // HEIC shared source: x265 analysis reuse across qualities
     bool psnr_show_msg = false;
 
-    // Allow user to reposition the three windows manually, but start them side‑by‑side
+    // Error heatmap
+    char hm_ref[512] = "";
+    char hm_cmp[512] = "";
+    int hm_tile_idx = 1;        // index into hm_tiles
+    const int hm_tiles[] = {8, 16, 32, 64};
+    float hm_psnr_lo = 25.0f;
+    float hm_psnr_hi = 50.0f;
+    float hm_alpha = 0.5f;
+    bool hm_show_overlay = true;
+    bool hm_overlay_dirty = false;
+    std::future<HeatmapJob> hm_future;
+    HeatmapJob hm_result;
+    GLuint hm_preview_tex = 0;
+    GLuint hm_overlay_tex = 0;
+    std::string hm_status;
+
+    // Allow user to reposition the windows manually, but start them side‑by‑side
     bool first_frame = true;
 
     // ------ Main loop ---------
@@ -105,7 +227,22 @@ inline int run_gui()
 
         ImGui::Checkbox("Encode (uncheck = Decode)", &heic_encode);
         if (heic_encode)
+        {
             ImGui::SliderInt("Quality", &heic_quality, 1, 100);
+            const char *colour_paths[] = {"RGB (libheif)", "YCbCr 4:2:0", "YCbCr 4:2:2", "YCbCr 4:4:4"};
+            ImGui::Combo("Colour", &heic_colour_path, colour_paths, IM_ARRAYSIZE(colour_paths));
+            if (heic_colour_path > 0)
+            {
+                ImGui::Checkbox("BT.709", &heic_bt709);
+                ImGui::SameLine();
+                ImGui::Checkbox("Full range", &heic_full_range);
+                if (heic_colour_path < 3)
+                {
+                    ImGui::SameLine();
+                    ImGui::Checkbox("Co-sited chroma", &heic_left_siting);
+                }
+            }
+        }
 
         if (ImGui::Button(heic_encode ? "Encode" : "Decode"))
         {
@@ -124,7 +261,21 @@ inline int run_gui()
                     if (heic_encode)
                     {
                         HeicEncoder enc(heic_in, heic_out); // updated constructor with output_path
-                        heic_done_ok = enc.encode(heic_quality);
+                        if (heic_colour_path == 0)
+                        {
+                            heic_done_ok = enc.encode(heic_quality);
+                        }
+                        else
+                        {
+                            HeicYCbCrOptions opts;
+                            opts.chroma = heic_colour_path == 3 ? ChromaFormat::C444
+                                        : heic_colour_path == 2 ? ChromaFormat::C422
+                                                                : ChromaFormat::C420;
+                            opts.matrix = heic_bt709 ? YCbCrMatrix::BT709 : YCbCrMatrix::BT601;
+                            opts.full_range = heic_full_range;
+                            opts.siting = heic_left_siting ? ChromaSiting::Left : ChromaSiting::Center;
+                            heic_done_ok = enc.encode_ycbcr(heic_quality, opts);
+                        }
                     }
                     else
                     {
@@ -215,6 +366,28 @@ inline int run_gui()
         if (ImGui::RadioButton("HEIC", !psnr_is_jpeg))
             psnr_is_jpeg = false;
         ImGui::Checkbox("Keep temp files", &keep_tmp_files);
+        if (psnr_is_jpeg)
+        {
+            ImGui::Checkbox("DCT once", &psnr_dct_once);
+            ImGui::SameLine();
+            ImGui::Checkbox("Estimate", &psnr_estimate);
+            if (psnr_estimate)
+            {
+                ImGui::SameLine();
+                ImGui::Checkbox("Verify by decode", &psnr_verify);
+            }
+        }
+        else
+        {
+            ImGui::Checkbox("Shared source", &psnr_shared_src);
+            if (psnr_shared_src)
+            {
+                ImGui::SameLine();
+                ImGui::Checkbox("Compare independent", &psnr_compare);
+                if (kHeicAnalysisReuseAvailable)
+                    ImGui::Checkbox("Reuse x265 analysis", &psnr_reuse);
+            }
+        }
 
         if (ImGui::Button("Run Sweep"))
         {
@@ -229,8 +402,20 @@ inline int run_gui()
                 }
                 try
                 {
-                    if (psnr_is_jpeg)
+                    if (psnr_is_jpeg && psnr_estimate)
+                        JpegEstimatePSNRtoCSV(psnr_img, psnr_csv, psnr_verify);
+                    else if (psnr_is_jpeg && psnr_dct_once)
+                        JpegDctOncePSNRtoCSV(psnr_img, psnr_csv, keep_tmp_files);
+                    else if (psnr_is_jpeg)
                         JpegPSNRtoCSV(psnr_img, psnr_csv, keep_tmp_files);
+                    else if (psnr_shared_src)
+                    {
+                        HeicAnalysisReuse reuse;
+                        reuse.enabled = psnr_reuse && kHeicAnalysisReuseAvailable;
+                        evaluateHeicSharedSourceSweep(psnr_img, psnr_csv, keep_tmp_files,
+                                                      {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100},
+                                                      psnr_compare, {}, reuse);
+                    }
                     else
                         evaluateHeicQualitySweep(psnr_img, psnr_csv, keep_tmp_files);
                     psnr_done_ok = true;
@@ -248,6 +433,118 @@ inline int run_gui()
 
         ImGui::End();
 
+        // ---------------- HEATMAP WINDOW ----------------
+        if (first_frame)
+        {
+            ImGui::SetNextWindowPos(ImVec2(10, 260));
+            ImGui::SetNextWindowSize(ImVec2(930, 330));
+        }
+        ImGui::Begin("Local Error Heatmap");
+
+        ImGui::InputText("Reference", hm_ref, IM_ARRAYSIZE(hm_ref));
+        ImGui::InputText("Compressed", hm_cmp, IM_ARRAYSIZE(hm_cmp));
+        const char *tile_names[] = {"8x8", "16x16", "32x32", "64x64"};
+        ImGui::Combo("Tile", &hm_tile_idx, tile_names, IM_ARRAYSIZE(tile_names));
+
+        const bool hm_busy = hm_future.valid();
+        if (ImGui::Button(hm_busy ? "Computing..." : "Compute") && !hm_busy &&
+            std::strlen(hm_ref) != 0 && std::strlen(hm_cmp) != 0)
+        {
+            hm_status.clear();
+            hm_future = std::async(std::launch::async, run_heatmap_job,
+                                   std::string(hm_ref), std::string(hm_cmp), hm_tiles[hm_tile_idx]);
+        }
+
+        // Pick up a finished job and upload its textures
+        if (hm_future.valid() &&
+            hm_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            hm_result = hm_future.get();
+            if (hm_result.ok)
+            {
+                upload_texture(hm_preview_tex, hm_result.preview.data(),
+                               hm_result.preview_w, hm_result.preview_h, GL_RGB);
+                hm_overlay_dirty = true;
+                char buf[128];
+                std::snprintf(buf, sizeof(buf), "%d x %d tiles in %.0f ms",
+                              hm_result.map.cols, hm_result.map.rows, hm_result.seconds * 1000.0);
+                hm_status = buf;
+            }
+            else
+            {
+                hm_status = "Error: " + hm_result.error;
+            }
+        }
+
+        if (hm_result.ok)
+        {
+            ImGui::SameLine();
+            if (ImGui::Button("Export CSV"))
+            {
+                const std::string out = change_extension(hm_cmp, "_heatmap.csv");
+                hm_status = writeHeatmapCSV(hm_result.map, out) ? "Wrote " + out : "Failed to write " + out;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Export binary"))
+            {
+                const std::string out = change_extension(hm_cmp, ".ehm");
+                hm_status = writeHeatmapBinary(hm_result.map, out) ? "Wrote " + out : "Failed to write " + out;
+            }
+
+            ImGui::Checkbox("Overlay", &hm_show_overlay);
+            ImGui::SameLine();
+            ImGui::SliderFloat("Opacity", &hm_alpha, 0.0f, 1.0f);
+            hm_overlay_dirty |= ImGui::SliderFloat("PSNR red", &hm_psnr_lo, 10.0f, 60.0f, "%.1f dB");
+            hm_overlay_dirty |= ImGui::SliderFloat("PSNR blue", &hm_psnr_hi, 10.0f, 70.0f, "%.1f dB");
+        }
+
+        if (!hm_status.empty())
+            ImGui::Text("%s", hm_status.c_str());
+
+        if (hm_result.ok)
+        {
+            if (hm_overlay_dirty)
+            {
+                std::vector<uint8_t> rgba;
+                heatmapToRGBA(hm_result.map, hm_psnr_lo, hm_psnr_hi, rgba);
+                upload_texture(hm_overlay_tex, rgba.data(), hm_result.map.cols, hm_result.map.rows, GL_RGBA);
+                hm_overlay_dirty = false;
+            }
+
+            // Fit the preview into the remaining space, keeping the aspect ratio
+            const ImVec2 avail = ImGui::GetContentRegionAvail();
+            const float scale = std::min(avail.x / hm_result.preview_w, avail.y / hm_result.preview_h);
+            if (scale > 0.0f)
+            {
+                const ImVec2 size(hm_result.preview_w * scale, hm_result.preview_h * scale);
+                const ImVec2 p0 = ImGui::GetCursorScreenPos();
+                const ImVec2 p1(p0.x + size.x, p0.y + size.y);
+                ImGui::Image((ImTextureID)(intptr_t)hm_preview_tex, size);
+
+                // Border tiles may extend past the image; crop the overlay to match
+                const ErrorHeatmap &map = hm_result.map;
+                const ImVec2 uv1(float(map.width) / (map.cols * map.tile),
+                                 float(map.height) / (map.rows * map.tile));
+                if (hm_show_overlay)
+                    ImGui::GetWindowDrawList()->AddImage((ImTextureID)(intptr_t)hm_overlay_tex, p0, p1,
+                                                         ImVec2(0, 0), uv1,
+                                                         IM_COL32(255, 255, 255, int(hm_alpha * 255.0f)));
+
+                if (ImGui::IsItemHovered())
+                {
+                    const ImVec2 m = ImGui::GetMousePos();
+                    const int px = std::clamp(int((m.x - p0.x) / size.x * map.width), 0, map.width - 1);
+                    const int py = std::clamp(int((m.y - p0.y) / size.y * map.height), 0, map.height - 1);
+                    const int col = px / map.tile;
+                    const int row = py / map.tile;
+                    ImGui::SetTooltip("tile (%d, %d)  PSNR %.2f dB  MSE %.2f", col, row,
+                                      map.psnr(col, row), map.mse[size_t(row) * map.cols + col]);
+                }
+            }
+        }
+
+        ImGui::End();
+
         first_frame = false;
 
         // Render
@@ -261,6 +558,12 @@ inline int run_gui()
     }
 
     // Cleanup
+    if (hm_future.valid())
+        hm_future.wait();
+    if (hm_preview_tex)
+        glDeleteTextures(1, &hm_preview_tex);
+    if (hm_overlay_tex)
+        glDeleteTextures(1, &hm_overlay_tex);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,202 @@
+// heatmap.h – header‑only tiled local‑error (MSE / PSNR) maps with CSV / binary export
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "helpers.h"             // sumSquaredErrorRGB / psnrFromMSE
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// Per‑tile error map
+// Tiles are tile×tile pixels, row‑major; tiles on the right / bottom border
+// cover only the remaining pixels.
+// ----------------------------------------------------------------------------
+struct ErrorHeatmap {
+    int width = 0;               // Image size in pixels
+    int height = 0;
+    int tile = 16;               // Tile edge length in pixels
+    int cols = 0;                // Number of tiles per row / column
+    int rows = 0;
+    std::vector<float> mse;      // Per‑tile mean squared error over R, G and B
+
+    float psnr(int col, int row) const {
+        return static_cast<float>(psnrFromMSE(mse[size_t(row) * cols + col]));
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Compute the map for two interleaved RGB images of equal size.
+// Tile rows are handed out to worker threads (0 = all cores).
+// ----------------------------------------------------------------------------
+inline ErrorHeatmap computeErrorHeatmap(const unsigned char* original, const unsigned char* decoded,
+                                        int width, int height, int tile, int threads = 0)
+{
+    ErrorHeatmap map;
+    map.width = width;
+    map.height = height;
+    map.tile = std::max(1, tile);
+    map.cols = (width + map.tile - 1) / map.tile;
+    map.rows = (height + map.tile - 1) / map.tile;
+    map.mse.assign(size_t(map.cols) * map.rows, 0.0f);
+    if (map.mse.empty()) return map;
+
+    std::atomic<int> next_row{0};
+    auto worker = [&]() {
+        for (int r = next_row++; r < map.rows; r = next_row++) {
+            const int y0 = r * map.tile;
+            const int th = std::min(map.tile, height - y0);
+            for (int c = 0; c < map.cols; ++c) {
+                const int x0 = c * map.tile;
+                const int tw = std::min(map.tile, width - x0);
+                const uint64_t sse = sumSquaredErrorRGB(original, decoded, width, x0, y0, tw, th);
+                map.mse[size_t(r) * map.cols + c] = static_cast<float>(double(sse) / (double(tw) * th * 3));
+            }
+        }
+    };
+
+    int n_threads = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+    n_threads = std::max(1, std::min(n_threads, map.rows));
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < n_threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& th : pool) th.join();
+    return map;
+}
+
+// ----------------------------------------------------------------------------
+// Export
+// CSV: one line per tile row, PSNR in dB per tile ("inf" for exact tiles).
+// Binary: "EHM1", then int32 width, height, tile, cols, rows followed by
+// cols·rows float32 MSE values, all little endian.
+// ----------------------------------------------------------------------------
+inline bool writeHeatmapCSV(const ErrorHeatmap& map, const std::string& path)
+{
+    std::ofstream csv(path, std::ios::trunc);
+    if (!csv) return false;
+
+    csv << std::fixed << std::setprecision(3);
+    for (int r = 0; r < map.rows; ++r) {
+        for (int c = 0; c < map.cols; ++c) {
+            if (c) csv << ',';
+            csv << map.psnr(c, r);
+        }
+        csv << '\n';
+    }
+    return bool(csv);
+}
+
+namespace heatmap_detail {
+
+// Fixed little‑endian byte order, independent of the host
+inline void put_le32(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+inline uint32_t get_le32(const uint8_t* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+} // namespace heatmap_detail
+
+inline bool writeHeatmapBinary(const ErrorHeatmap& map, const std::string& path)
+{
+    using namespace heatmap_detail;
+    std::vector<uint8_t> bytes = {'E', 'H', 'M', '1'};
+    bytes.reserve(4 + 5 * 4 + map.mse.size() * 4);
+    for (int32_t v : {map.width, map.height, map.tile, map.cols, map.rows}) put_le32(bytes, uint32_t(v));
+    for (float v : map.mse) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, 4);
+        put_le32(bytes, bits);
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    out.close();
+    return bool(out);
+}
+
+// Rejects files whose header does not describe a tiling of the image or
+// whose size does not match it, before anything is allocated
+inline bool readHeatmapBinary(const std::string& path, ErrorHeatmap& map)
+{
+    using namespace heatmap_detail;
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const std::streamoff file_size = in.tellg();
+    in.seekg(0);
+
+    uint8_t head[4 + 5 * 4];
+    if (file_size < std::streamoff(sizeof(head)) || !in.read(reinterpret_cast<char*>(head), sizeof(head)) ||
+        std::memcmp(head, "EHM1", 4) != 0)
+        return false;
+
+    int32_t h[5];
+    for (int i = 0; i < 5; ++i) h[i] = int32_t(get_le32(head + 4 + 4 * i));
+    const int32_t width = h[0], height = h[1], tile = h[2], cols = h[3], rows = h[4];
+    if (width < 0 || height < 0 || tile < 1) return false;
+    if (cols != (int64_t(width) + tile - 1) / tile || rows != (int64_t(height) + tile - 1) / tile) return false;
+    const uint64_t tiles = uint64_t(cols) * uint64_t(rows);
+    if (uint64_t(file_size) - sizeof(head) != tiles * 4) return false;
+
+    std::vector<uint8_t> payload(size_t(tiles) * 4);
+    if (!in.read(reinterpret_cast<char*>(payload.data()), std::streamsize(payload.size()))) return false;
+
+    map.width = width;
+    map.height = height;
+    map.tile = tile;
+    map.cols = cols;
+    map.rows = rows;
+    map.mse.resize(size_t(tiles));
+    for (size_t i = 0; i < map.mse.size(); ++i) {
+        const uint32_t bits = get_le32(payload.data() + 4 * i);
+        std::memcpy(&map.mse[i], &bits, 4);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Colour mapping for display: PSNR ≤ psnr_lo is red (bad), ≥ psnr_hi is blue
+// (good), in between runs red → yellow → green → cyan → blue. One RGBA texel
+// per tile; alpha is left to the renderer.
+// ----------------------------------------------------------------------------
+inline void heatmapToRGBA(const ErrorHeatmap& map, float psnr_lo, float psnr_hi,
+                          std::vector<uint8_t>& rgba)
+{
+    rgba.resize(map.mse.size() * 4);
+    const float span = std::max(psnr_hi - psnr_lo, 1e-3f);
+
+    for (size_t i = 0; i < map.mse.size(); ++i) {
+        const float p = static_cast<float>(psnrFromMSE(map.mse[i]));
+        const float t = std::isinf(p) ? 1.0f : std::clamp((p - psnr_lo) / span, 0.0f, 1.0f);
+
+        // Piecewise linear hue ramp over four segments
+        const float s = t * 4.0f;
+        float r, g, b;
+        if (s < 1.0f)      { r = 1.0f;     g = s;        b = 0.0f; }
+        else if (s < 2.0f) { r = 2.0f - s; g = 1.0f;     b = 0.0f; }
+        else if (s < 3.0f) { r = 0.0f;     g = 1.0f;     b = s - 2.0f; }
+        else               { r = 0.0f;     g = 4.0f - s; b = 1.0f; }
+
+        rgba[i * 4 + 0] = static_cast<uint8_t>(r * 255.0f + 0.5f);
+        rgba[i * 4 + 1] = static_cast<uint8_t>(g * 255.0f + 0.5f);
+        rgba[i * 4 + 2] = static_cast<uint8_t>(b * 255.0f + 0.5f);
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+#endif // HEATMAP_H
@@ -7,9 +7,13 @@
 #include <stb_image.h>           // Image loading (PNG, JPEG, etc.)
 #include "stb_image_write.h"     // Image writing (PNG, BMP, etc.)
 #include "helpers.h"             // Helper functions (e.g., PSNR calculation)
+#include "colorconv.h"           // SIMD RGB → YCbCr conversion for the planar encode path
 
 #include <libheif/heif.h>        // Main library for HEIC encoding/decoding
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <cstring>
 #include <vector>
@@ -18,6 +22,22 @@
 #include <iostream>
 #include <cmath>
 #include <filesystem>            // C++17 for temp file handling and file size
+#include <random>
+#include <utility>
+
+// ----------------------------------------------------------------------------
+// Settings for the planar YCbCr encode path
+// ----------------------------------------------------------------------------
+struct HeicYCbCrOptions {
+    ChromaFormat chroma = ChromaFormat::C420;   // chroma subsampling handed to x265
+    YCbCrMatrix matrix = YCbCrMatrix::BT601;    // matrix coefficients (signalled via NCLX)
+    bool full_range = true;                     // full (0–255) or limited (16–235) range
+    ChromaSiting siting = ChromaSiting::Center; // chroma position, signalled to x265 for 4:2:0
+    int threads = 0;                            // conversion threads, 0 = all cores
+};
+
+// Additional encoder parameters as (name, value), e.g. {"x265:analysis-save", path}
+using HeicEncoderParams = std::vector<std::pair<std::string, std::string>>;
 
 // ----------------------------------------------------------------------------
 // HEIC Encoder class
@@ -38,52 +58,176 @@ public:
         unsigned char* data = stbi_load(input_path_.c_str(), &w, &h, &comp, 3);
         if (!data) return false;
 
-        // Allocate HEIF context and image container
-        heif_context* ctx = heif_context_alloc();
+        heif_image* img = make_rgb_image(data, w, h);
+        stbi_image_free(data);  // Free original image memory
+        if (!img) return false;
+
+        // libheif converts RGB → YCbCr 4:2:0 internally
+        return encode_image(img, quality, nullptr);
+    }
+
+    // Encode the input image to HEIC, doing the colour conversion ourselves.
+    // The planes are written straight into a YCbCr heif_image, so libheif
+    // skips its own scalar conversion, and the chroma format / matrix / range
+    // are signalled with a matching NCLX profile.
+    bool encode_ycbcr(int quality = 90, const HeicYCbCrOptions& opts = {}) const {
+        int w, h, comp;
+        unsigned char* data = stbi_load(input_path_.c_str(), &w, &h, &comp, 3);
+        if (!data) return false;
+
+        heif_image* img = make_ycbcr_image(data, w, h, opts);
+        stbi_image_free(data);
+        if (!img) return false;
+
+        return encode_image(img, quality, chroma_param(opts.chroma), ycbcr_params(opts));
+    }
+
+    // Convert tightly packed interleaved RGB into a new planar YCbCr heif_image
+    // with matching NCLX profile (nullptr on failure)
+    static heif_image* make_ycbcr_image(const unsigned char* rgb, int w, int h,
+                                        const HeicYCbCrOptions& opts = {}) {
+        const heif_chroma chroma = opts.chroma == ChromaFormat::C444 ? heif_chroma_444
+                                 : opts.chroma == ChromaFormat::C422 ? heif_chroma_422
+                                                                     : heif_chroma_420;
         heif_image* img = nullptr;
+        const heif_error err = heif_image_create(w, h, heif_colorspace_YCbCr, chroma, &img);
+        if (err.code) return nullptr;
+
+        const int cw = chroma_width(opts.chroma, w);
+        const int ch = chroma_height(opts.chroma, h);
+        heif_image_add_plane(img, heif_channel_Y, w, h, 8);
+        heif_image_add_plane(img, heif_channel_Cb, cw, ch, 8);
+        heif_image_add_plane(img, heif_channel_Cr, cw, ch, 8);
+
+        YCbCrPlanes planes{};
+        planes.y  = heif_image_get_plane(img, heif_channel_Y,  &planes.y_stride);
+        planes.cb = heif_image_get_plane(img, heif_channel_Cb, &planes.cb_stride);
+        planes.cr = heif_image_get_plane(img, heif_channel_Cr, &planes.cr_stride);
+
+        rgbToYCbCr(rgb, w, h, w * 3, planes, opts.chroma, opts.matrix, opts.full_range, opts.threads,
+                   opts.siting);
+
+        // Describe the samples we produced: sRGB primaries / transfer,
+        // selected matrix and range
+        heif_nclx_color_profile* nclx = heif_nclx_color_profile_alloc();
+        nclx->color_primaries = heif_color_primaries_ITU_R_BT_709_5;
+        nclx->transfer_characteristics = heif_transfer_characteristic_IEC_61966_2_1;
+        nclx->matrix_coefficients = opts.matrix == YCbCrMatrix::BT709
+                                    ? heif_matrix_coefficients_ITU_R_BT_709_5
+                                    : heif_matrix_coefficients_ITU_R_BT_601_6;
+        nclx->full_range_flag = opts.full_range ? 1 : 0;
+        heif_image_set_nclx_color_profile(img, nclx);
+        heif_nclx_color_profile_free(nclx);
+        return img;
+    }
 
+    // x265 must be told the chroma format, otherwise libheif resamples to 4:2:0
+    static const char* chroma_param(ChromaFormat format) {
+        return format == ChromaFormat::C444 ? "444"
+             : format == ChromaFormat::C422 ? "422" : "420";
+    }
+
+    // Encoder parameters describing an image from make_ycbcr_image beyond
+    // NCLX: the chroma sample location (VUI chroma_loc_info). HEVC only
+    // signals it for 4:2:0; 4:2:2 chroma is defined as co‑sited (Left).
+    static HeicEncoderParams ycbcr_params(const HeicYCbCrOptions& opts) {
+        if (opts.chroma != ChromaFormat::C420) return {};
+        return {{"x265:chromaloc", opts.siting == ChromaSiting::Left ? "0" : "1"}};
+    }
+
+    // Copy tightly packed interleaved RGB into a new heif_image (nullptr on failure)
+    static heif_image* make_rgb_image(const unsigned char* rgb, int w, int h) {
         // Create a new HEIF image with RGB interleaved layout
-        heif_error err = heif_image_create(w, h, heif_colorspace_RGB,
+        heif_image* img = nullptr;
+        const heif_error err = heif_image_create(w, h, heif_colorspace_RGB,
             heif_chroma_interleaved_RGB, &img);
-        if (err.code) {
-            stbi_image_free(data);
-            heif_context_free(ctx);
-            return false;
-        }
+        if (err.code) return nullptr;
 
         // Add interleaved RGB plane with 8 bits per channel
         heif_image_add_plane(img, heif_channel_interleaved, w, h, 8);
-        uint8_t* dst = heif_image_get_plane(img, heif_channel_interleaved, nullptr);
+        int stride = 0;
+        uint8_t* dst = heif_image_get_plane(img, heif_channel_interleaved, &stride);
 
-        // Copy input data to HEIF image buffer
-        std::memcpy(dst, data, size_t(w * 3) * h);
-        stbi_image_free(data);  // Free original image memory
+        // Copy input data to HEIF image buffer (rows may be padded)
+        for (int y = 0; y < h; ++y)
+            std::memcpy(dst + size_t(y) * stride, rgb + size_t(y) * w * 3, size_t(w) * 3);
+        return img;
+    }
+
+    // Encode a prepared image with HEVC into memory. img is not released, so
+    // one image can be encoded at several qualities.
+    static bool encode_to_memory(const heif_image* img, int quality, std::vector<uint8_t>& heic,
+                                 const char* chroma = nullptr, const HeicEncoderParams& params = {}) {
+        heif_context* ctx = encode_to_context(img, quality, chroma, params);
+        if (!ctx) return false;
+
+        heif_writer writer{};
+        writer.writer_api_version = 1;
+        writer.write = [](heif_context*, const void* data, size_t size, void* userdata) {
+            auto* out = static_cast<std::vector<uint8_t>*>(userdata);
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            out->insert(out->end(), bytes, bytes + size);
+            return heif_error{heif_error_Ok, heif_suberror_Unspecified, "Success"};
+        };
+        heic.clear();
+        const heif_error err = heif_context_write(ctx, &writer, &heic);
+        heif_context_free(ctx);
+        return err.code == 0;
+    }
+
+private:
+    // Encode a prepared image with HEVC and write it out. Takes ownership of img.
+    bool encode_image(heif_image* img, int quality, const char* chroma,
+                      const HeicEncoderParams& params = {}) const {
+        heif_context* ctx = encode_to_context(img, quality, chroma, params);
+        heif_image_release(img);
+        if (!ctx) return false;
+
+        // Determine output path if not provided
+        const std::string out_path = output_path_.empty() ? default_out_path(".heic") : output_path_;
+
+        // Write encoded image to file
+        const heif_error err = heif_context_write_to_file(ctx, out_path.c_str());
+        heif_context_free(ctx);
+        return err.code == 0;
+    }
+
+    // Run the HEVC encoder on img; returns a context holding the result or
+    // nullptr on failure
+    static heif_context* encode_to_context(const heif_image* img, int quality, const char* chroma,
+                                           const HeicEncoderParams& params = {}) {
+        heif_context* ctx = heif_context_alloc();
 
         // Set up HEVC encoder
         heif_encoder* enc;
         heif_context_get_encoder_for_format(ctx, heif_compression_HEVC, &enc);
         heif_encoder_set_lossy_quality(enc, quality);  // Set compression quality
+        // A rejected chroma format would silently resample to 4:2:0
+        if (chroma && heif_encoder_set_parameter_string(enc, "chroma", chroma).code) {
+            heif_encoder_release(enc);
+            heif_context_free(ctx);
+            return nullptr;
+        }
+        for (const auto& [name, value] : params) {
+            if (heif_encoder_set_parameter_string(enc, name.c_str(), value.c_str()).code) {
+                heif_encoder_release(enc);
+                heif_context_free(ctx);
+                return nullptr;
+            }
+        }
 
         // Encode image and get handle
-        heif_image_handle* handle;
-        err = heif_context_encode_image(ctx, img, enc, nullptr, &handle);
+        heif_image_handle* handle = nullptr;
+        const heif_error err = heif_context_encode_image(ctx, img, enc, nullptr, &handle);
         heif_encoder_release(enc);
-        heif_image_release(img);
         if (err.code) {
             heif_context_free(ctx);
-            return false;
+            return nullptr;
         }
-
-        // Determine output path if not provided
-        const std::string out_path = output_path_.empty() ? default_out_path(".heic") : output_path_;
-
-        // Write encoded image to file
-        err = heif_context_write_to_file(ctx, out_path.c_str());
-        heif_context_free(ctx);
-        return err.code == 0;
+        heif_image_handle_release(handle);
+        return ctx;
     }
 
-private:
     // Generates default output path based on input file and new extension
     std::string default_out_path(const char* ext) const {
         const size_t dot = input_path_.find_last_of('.');
@@ -107,6 +251,22 @@ public:
 
     // Decode HEIC image to PNG
     bool decode() const {
+        std::vector<uint8_t> rgb;
+        int w = 0, h = 0;
+        if (!decode_to_rgb(rgb, w, h))
+            return false;
+
+        // Determine output PNG path
+        const std::string out_path = output_path_.empty() ? default_out_path(".png") : output_path_;
+
+        // Write PNG using stb_image_write
+        const int ok = stbi_write_png(out_path.c_str(), w, h, 3, rgb.data(), w * 3);
+        fprintf(stdout, "Reading done %d\n", ok);
+        return ok != 0;
+    }
+
+    // Decode HEIC image into a tightly packed interleaved RGB buffer
+    bool decode_to_rgb(std::vector<uint8_t>& rgb, int& w, int& h) const {
         // Load HEIC context from file
         heif_context* ctx = heif_context_alloc();
         heif_error err = heif_context_read_from_file(ctx, input_path_.c_str(), nullptr);
@@ -115,10 +275,28 @@ public:
             fprintf(stderr, "Error reading from file %d\n", err.code);
             return false;
         }
+        return decode_context_to_rgb(ctx, rgb, w, h);
+    }
+
+    // Same for a HEIC file held in memory (e.g. from HeicEncoder::encode_to_memory)
+    static bool decode_memory_to_rgb(const uint8_t* data, size_t size,
+                                     std::vector<uint8_t>& rgb, int& w, int& h) {
+        heif_context* ctx = heif_context_alloc();
+        heif_error err = heif_context_read_from_memory_without_copy(ctx, data, size, nullptr);
+        if (err.code) {
+            heif_context_free(ctx);
+            fprintf(stderr, "Error reading from memory %d\n", err.code);
+            return false;
+        }
+        return decode_context_to_rgb(ctx, rgb, w, h);
+    }
 
+private:
+    // Decode the primary image of ctx to RGB. Frees ctx.
+    static bool decode_context_to_rgb(heif_context* ctx, std::vector<uint8_t>& rgb, int& w, int& h) {
         // Get handle to primary image
         heif_image_handle* handle;
-        err = heif_context_get_primary_image_handle(ctx, &handle);
+        heif_error err = heif_context_get_primary_image_handle(ctx, &handle);
         if (err.code) {
             heif_context_free(ctx);
             fprintf(stderr, "Error getting image handle %d\n", err.code);
@@ -136,25 +314,22 @@ public:
             return false;
         }
 
-        // Get image dimensions and pixel data
-        const int w = heif_image_get_width(img, heif_channel_interleaved);
-        const int h = heif_image_get_height(img, heif_channel_interleaved);
-        const uint8_t* src = heif_image_get_plane_readonly(img, heif_channel_interleaved, nullptr);
+        // Get image dimensions and copy the (possibly padded) rows out
+        w = heif_image_get_width(img, heif_channel_interleaved);
+        h = heif_image_get_height(img, heif_channel_interleaved);
+        int stride = 0;
+        const uint8_t* src = heif_image_get_plane_readonly(img, heif_channel_interleaved, &stride);
 
-        // Determine output PNG path
-        const std::string out_path = output_path_.empty() ? default_out_path(".png") : output_path_;
-
-        // Write PNG using stb_image_write
-        const int ok = stbi_write_png(out_path.c_str(), w, h, 3, src, w * 3);
-        fprintf(stdout, "Reading done %d\n", ok);
+        rgb.resize(size_t(w) * h * 3);
+        for (int y = 0; y < h; ++y)
+            std::memcpy(rgb.data() + size_t(y) * w * 3, src + size_t(y) * stride, size_t(w) * 3);
 
         // Cleanup
         heif_image_release(img);
         heif_context_free(ctx);
-        return ok != 0;
+        return true;
     }
 
-private:
     // Generates default output path based on input file and new extension
     std::string default_out_path(const char* ext) const {
         const size_t dot = input_path_.find_last_of('.');
@@ -287,4 +462,273 @@ inline bool evaluateHeicQualitySweep(
     return true;
 }
 
+// ----------------------------------------------------------------------------
+// x265 analysis reuse for the shared‑source sweep
+// One quality (the anchor) is encoded with "x265:analysis-save"; every other
+// quality loads that analysis ("x265:analysis-load") so x265 takes the CU
+// partitioning from the anchor instead of searching it again. refine_intra
+// selects how much is re‑evaluated at the new quality (x265 --refine-intra):
+// 0 = depth and modes forced, 3 = depth reused / modes re‑evaluated,
+// 4 = nothing reused.
+//
+// libheif's stock x265 plugin passes no output picture to x265 and crashes
+// on analysis-save. Configuring with -DHEIC_DEMO_X265_ANALYSIS_REUSE=ON
+// patches the pinned libheif build (cmake/patch_libheif_x265.cmake) and
+// defines HEIC_DEMO_X265_ANALYSIS_REUSE; otherwise the mode is refused.
+// An anchor that is not in the quality list is encoded for its analysis
+// only and gets no CSV row.
+// ----------------------------------------------------------------------------
+#ifdef HEIC_DEMO_X265_ANALYSIS_REUSE
+inline constexpr bool kHeicAnalysisReuseAvailable = true;
+#else
+inline constexpr bool kHeicAnalysisReuseAvailable = false;
+#endif
+
+struct HeicAnalysisReuse {
+    bool enabled = false;
+    int anchor_quality = -1;    // quality of the analysis pass, -1 = median of the sweep
+    int reuse_level = 10;       // analysis-save/-load-reuse-level, 10 = incl. CU depth
+    int refine_intra = 3;
+};
+
+// Wall time and deviation of a shared‑source sweep against its reference
+// (compare_independent); all zero without a reference run
+struct HeicSweepComparison {
+    double shared_s = 0.0;
+    double independent_s = 0.0;
+    double max_psnr_dev = 0.0;      // |dB|, lossless points excluded
+    double max_size_dev_pct = 0.0;  // |%|
+    size_t compared = 0;            // qualities present in both runs
+};
+
+namespace heic_sweep_detail {
+
+// Fresh path in the temp directory for one call's scratch file. A random
+// per-process tag plus a counter, so concurrent sweeps, parallel workers and
+// images with the same stem never share a file.
+inline std::filesystem::path unique_temp_path(const std::string& suffix)
+{
+    static const uint64_t process_tag = (uint64_t(std::random_device{}()) << 32) ^ std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    std::error_code ec;
+    std::filesystem::path p;
+    do {
+        p = std::filesystem::temp_directory_path() /
+            ("heic_demo_" + std::to_string(process_tag) + "_" + std::to_string(counter++) + suffix);
+    } while (std::filesystem::exists(p, ec));
+    return p;
+}
+
+// Encode + decode source at every quality (result order = qualities order)
+// with the base parameters (ycbcr_params). With reuse.enabled the anchor runs
+// first and saves its analysis to analysis_file, the other qualities load it;
+// an anchor that is not in qualities only produces the analysis, no row.
+inline std::vector<HeicQualityResult> encode_qualities(
+    const heif_image* source, const unsigned char* reference, int w, int h,
+    const std::vector<int>& qualities, const char* chroma, const HeicEncoderParams& base,
+    const HeicAnalysisReuse& reuse, const std::string& analysis_file,
+    const std::filesystem::path* keep_prefix)
+{
+    std::vector<HeicQualityResult> results;
+    std::vector<uint8_t> heic, decoded;
+
+    auto run = [&](int q, const HeicEncoderParams& extra, bool record) {
+        HeicEncoderParams params = base;
+        params.insert(params.end(), extra.begin(), extra.end());
+        if (!HeicEncoder::encode_to_memory(source, q, heic, chroma, params)) {
+            std::cerr << "(HEIC SWEEP) Encoding failed at quality=" << q << '\n';
+            return false;
+        }
+        int dec_w = 0, dec_h = 0;
+        if (!HeicDecoder::decode_memory_to_rgb(heic.data(), heic.size(), decoded, dec_w, dec_h)) {
+            std::cerr << "(HEIC SWEEP) Decoding failed at quality=" << q << '\n';
+            return false;
+        }
+        if (dec_w != w || dec_h != h) {
+            std::cerr << "(HEIC SWEEP) Dimension mismatch at quality=" << q << '\n';
+            return false;
+        }
+        if (!record) return true;
+        results.push_back({q, computePSNR(reference, decoded.data(), w, h), heic.size()});
+
+        if (keep_prefix) {
+            const std::string encoded_path = keep_prefix->string() + "_q" + std::to_string(q) + ".heic";
+            std::ofstream(encoded_path, std::ios::binary)
+                .write(reinterpret_cast<const char*>(heic.data()), std::streamsize(heic.size()));
+        }
+        return true;
+    };
+
+    HeicEncoderParams load;
+    int anchor = -1;
+    if (reuse.enabled && !qualities.empty()) {
+        std::vector<int> sorted = qualities;
+        std::sort(sorted.begin(), sorted.end());
+        anchor = reuse.anchor_quality >= 0 ? reuse.anchor_quality : sorted[sorted.size() / 2];
+
+        const std::string level = std::to_string(reuse.reuse_level);
+        const HeicEncoderParams save = {{"x265:analysis-save", analysis_file},
+                                        {"x265:analysis-save-reuse-level", level}};
+        const bool requested = std::find(qualities.begin(), qualities.end(), anchor) != qualities.end();
+        if (!run(anchor, save, requested)) return {};
+        load = {{"x265:analysis-load", analysis_file},
+                {"x265:analysis-load-reuse-level", level},
+                {"x265:refine-intra", std::to_string(reuse.refine_intra)}};
+    }
+
+    for (int q : qualities)
+        if (q != anchor) run(q, load, true);
+
+    std::stable_sort(results.begin(), results.end(), [&](const HeicQualityResult& a, const HeicQualityResult& b) {
+        return std::find(qualities.begin(), qualities.end(), a.quality) <
+               std::find(qualities.begin(), qualities.end(), b.quality);
+    });
+    return results;
+}
+
+} // namespace heic_sweep_detail
+
+// ----------------------------------------------------------------------------
+// Shared‑source quality sweep
+// Same CSV as evaluateHeicQualitySweep, but the per‑image work is done once:
+// the source is loaded and converted to planar YCbCr a single time
+// (make_ycbcr_image), every quality encodes that image into memory and is
+// decoded from memory, so there is no per‑quality reload, colour conversion
+// or PNG round trip. With reuse.enabled x265's analysis is shared as well
+// (see HeicAnalysisReuse).
+//
+// With compare_independent = true a reference sweep is run as well; the CSV
+// then gains its PSNR / size and the deviation per quality, and the total
+// wall‑time speedup is printed. The reference is the classic sweep, or with
+// analysis reuse the same shared source encoded independently per quality,
+// so the deviation is that of the reuse alone.
+// ----------------------------------------------------------------------------
+inline bool evaluateHeicSharedSourceSweep(
+    const std::string& image_path,
+    const std::string& csv_path = "heic_quality.csv",
+    bool keep_temp_files = false,
+    const std::vector<int>& qualities = {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100},
+    bool compare_independent = false,
+    const HeicYCbCrOptions& opts = {},
+    const HeicAnalysisReuse& reuse = {},
+    HeicSweepComparison* comparison = nullptr)
+{
+    if (reuse.enabled && !kHeicAnalysisReuseAvailable) {
+        std::cerr << "(HEIC SWEEP) x265 analysis reuse needs the patched libheif of the pinned codec build\n";
+        return false;
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto t0 = clock::now();
+
+    int ref_w, ref_h, ref_comp;
+    unsigned char* reference =
+        stbi_load(image_path.c_str(), &ref_w, &ref_h, &ref_comp, 3 /*force RGB*/);
+    if (!reference) {
+        std::cerr << "(HEIC SWEEP) Could not load reference image: " << image_path << '\n';
+        return false;
+    }
+
+    heif_image* source = HeicEncoder::make_ycbcr_image(reference, ref_w, ref_h, opts);
+    if (!source) {
+        std::cerr << "(HEIC SWEEP) Could not create YCbCr image\n";
+        stbi_image_free(reference);
+        return false;
+    }
+
+    const std::filesystem::path img_path(image_path);
+    const std::string stem = img_path.stem().string();
+    const std::filesystem::path keep_prefix = img_path.parent_path() / stem;
+    const std::filesystem::path analysis_file = heic_sweep_detail::unique_temp_path("_x265.analysis");
+    const char* chroma = HeicEncoder::chroma_param(opts.chroma);
+    const HeicEncoderParams base = HeicEncoder::ycbcr_params(opts);
+    const double prepare_s = std::chrono::duration<double>(clock::now() - t0).count();
+
+    const auto t1 = clock::now();
+    const std::vector<HeicQualityResult> results = heic_sweep_detail::encode_qualities(
+        source, reference, ref_w, ref_h, qualities, chroma, base, reuse, analysis_file.string(),
+        keep_temp_files ? &keep_prefix : nullptr);
+    const double shared_s = prepare_s + std::chrono::duration<double>(clock::now() - t1).count();
+    std::error_code ec;
+    std::filesystem::remove(analysis_file, ec);
+
+    // ---- Optional reference run --------------------------------------------
+    std::vector<HeicQualityResult> independent;
+    double independent_s = 0.0;
+    if (compare_independent && reuse.enabled) {
+        const auto t2 = clock::now();
+        independent = heic_sweep_detail::encode_qualities(
+            source, reference, ref_w, ref_h, qualities, chroma, base, {}, {}, nullptr);
+        independent_s = prepare_s + std::chrono::duration<double>(clock::now() - t2).count();
+    }
+
+    heif_image_release(source);
+    stbi_image_free(reference);
+    if (reuse.enabled && results.empty()) {
+        std::cerr << "(HEIC SWEEP) Analysis pass failed\n";
+        return false;
+    }
+
+    if (compare_independent && !reuse.enabled) {
+        const std::filesystem::path tmp_csv = heic_sweep_detail::unique_temp_path("_heic_independent.csv");
+        const auto t2 = clock::now();
+        if (evaluateHeicQualitySweep(image_path, tmp_csv.string(), false, qualities)) {
+            independent_s = std::chrono::duration<double>(clock::now() - t2).count();
+            std::ifstream in(tmp_csv);
+            std::string line;
+            std::getline(in, line);  // header
+            HeicQualityResult r{};
+            char comma;
+            while (in >> r.quality >> comma >> r.psnr >> comma >> r.file_size)
+                independent.push_back(r);
+        }
+        std::filesystem::remove(tmp_csv, ec);
+    }
+
+    // ---- CSV ----------------------------------------------------------------
+    std::ofstream csv(csv_path, std::ios::trunc);
+    if (!csv) {
+        std::cerr << "(HEIC SWEEP) Unable to open CSV for writing: " << csv_path << '\n';
+        return false;
+    }
+    csv << "quality,psnr,size_bytes";
+    if (compare_independent) csv << ",psnr_independent,size_bytes_independent,psnr_dev,size_dev_pct";
+    csv << '\n';
+
+    double max_psnr_dev = 0.0, max_size_dev = 0.0;
+    size_t compared = 0;
+    for (const HeicQualityResult& r : results) {
+        csv << r.quality << ',' << std::fixed << std::setprecision(4) << r.psnr << ',' << r.file_size;
+        if (compare_independent) {
+            const auto it = std::find_if(independent.begin(), independent.end(),
+                                         [&](const HeicQualityResult& i) { return i.quality == r.quality; });
+            if (it != independent.end()) {
+                const double psnr_dev = r.psnr - it->psnr;
+                const double size_dev = 100.0 * (double(r.file_size) / double(std::max<std::uintmax_t>(it->file_size, 1)) - 1.0);
+                if (std::isfinite(psnr_dev)) max_psnr_dev = std::max(max_psnr_dev, std::abs(psnr_dev));
+                max_size_dev = std::max(max_size_dev, std::abs(size_dev));
+                ++compared;
+                csv << ',' << it->psnr << ',' << it->file_size << ',' << psnr_dev << ','
+                    << std::setprecision(2) << size_dev;
+            } else {
+                csv << ",,,,";
+            }
+        }
+        csv << '\n';
+    }
+    csv.close();
+
+    if (comparison && compare_independent && independent_s > 0.0)
+        *comparison = {shared_s, independent_s, max_psnr_dev, max_size_dev, compared};
+
+    std::cout << "(HEIC SWEEP) Results written to " << csv_path << '\n';
+    if (compare_independent && independent_s > 0.0)
+        std::cout << "(HEIC SWEEP) " << (reuse.enabled ? "Analysis reuse " : "Shared source ")
+                  << std::setprecision(2) << shared_s << " s, independent "
+                  << independent_s << " s (speedup " << independent_s / shared_s << "x), max |dPSNR| "
+                  << std::setprecision(3) << max_psnr_dev << " dB, max |dSize| "
+                  << std::setprecision(2) << max_size_dev << " %\n";
+    return true;
+}
+
 #endif // HEIC_EXTENDED_H
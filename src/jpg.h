@@ -1,3 +1,4 @@
+#pragma once
 #include "stb_image.h"
 #include <turbojpeg.h>
 
@@ -75,6 +76,7 @@ public:
     int getHeight() { return this->height; }
     int getChannels() { return this->channels; }
     unsigned char* getData() const { return this->data; }
+    const unsigned char* getRGBAData() const { return this->data_with_alpha; }   // as loaded, before the mask
 
 
     bool jpeg_compress(int quality)
@@ -155,9 +157,15 @@ public:
             return false;
         }
 
+        return jpeg_decompress_buffer(jpegBuf.data(), static_cast<unsigned long>(jpegSize));
+    }
+
+    // Decode a JPEG that is already in memory
+    bool jpeg_decompress_buffer(const unsigned char* jpegBuf, unsigned long jpegSize)
+    {
         tjhandle decompressor = tjInitDecompress();
 
-        if (tjDecompressHeader3(decompressor, jpegBuf.data(), jpegSize, &width, &height, &jpegSubsamp, &jpegColorspace) != 0) {
+        if (tjDecompressHeader3(decompressor, jpegBuf, jpegSize, &width, &height, &jpegSubsamp, &jpegColorspace) != 0) {
             std::cerr << "Header read failed: " << tjGetErrorStr() << std::endl;
             tjDestroy(decompressor);
             return false;
@@ -167,7 +175,7 @@ public:
 
         if (tjDecompress2(
             decompressor,
-            jpegBuf.data(), jpegSize,
+            jpegBuf, jpegSize,
             rgbBuffer.data(), width, 0, height,
             TJPF_RGB, TJFLAG_FASTDCT) != 0)
         {
@@ -198,8 +206,14 @@ void JpegPSNRtoCSV(const std::string& imgPath,
     const int w = reference.getWidth();
     const int h = reference.getHeight();
 
-    struct Row { int quality; double psnr; std::uintmax_t bytes; };
-    std::vector<Row> rows;
+    /* Rows are written and flushed as they are produced, so an aborted
+       sweep keeps everything measured so far                          */
+    std::ofstream csv(csvPath, std::ios::trunc);
+    if (!csv) throw std::runtime_error("cannot open CSV for writing");
+
+    csv << "quality,psnr,size_bytes\n";
+    csv << std::fixed << std::setprecision(6);
+    size_t rows = 0;
 
     /* Iterate over quality levels                                     */
     for (int q : qualities)
@@ -240,7 +254,9 @@ void JpegPSNRtoCSV(const std::string& imgPath,
             std::cerr << "Warning: cannot stat \"" << tmpName << "\": " << e.what() << '\n';
         }
 
-        rows.push_back({q, psnr, bytes});
+        csv << q << ',' << psnr << ',' << bytes << '\n';
+        csv.flush();  // one encode + decode per row, the flush is negligible
+        ++rows;
 
         /* e) Clean-up temp file if desired ---------------------------- */
         if (!keepTempFiles) {
@@ -249,16 +265,5 @@ void JpegPSNRtoCSV(const std::string& imgPath,
         }
     }
 
-    /* ------------------------------------------------------------------ */
-    /* 3) Write CSV                                                      */
-    /* ------------------------------------------------------------------ */
-    std::ofstream csv(csvPath, std::ios::trunc);
-    if (!csv) throw std::runtime_error("cannot open CSV for writing");
-
-    csv << "quality,psnr,size_bytes\n";
-    csv << std::fixed << std::setprecision(6);
-    for (const Row& r : rows)
-        csv << r.quality << ',' << r.psnr << ',' << r.bytes << '\n';
-
-    std::cout << "Wrote " << rows.size() << " rows to " << csvPath << '\n';
+    std::cout << "Wrote " << rows << " rows to " << csvPath << '\n';
 }
@@ -0,0 +1,513 @@
+// jpg_sweep.h – header‑only JPEG quality sweep that runs colour conversion and DCT once per image
+//
+// tjCompress2 repeats RGB → YCbCr, forward DCT, quantisation and Huffman coding
+// for every quality, although only the quantisation tables change. Here the
+// first two stages run once; each quality then only quantises the stored
+// coefficients and hands them to libjpeg's transcoding API
+// (jpeg_write_coefficients) for entropy coding.
+
+#pragma once
+
+#include "jpg.h"                 // JpgEncoder (alpha mask), JpgDecoder
+#include "colorconv.h"           // rgbToYCbCr
+#include "helpers.h"             // computePSNR
+
+#include <cstdio>                // jpeglib.h needs FILE
+#include <jpeglib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace jpg_sweep_detail {
+
+// libjpeg reports fatal errors through error_exit; jump back instead of exit()
+struct ErrorManager {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+inline void error_exit(j_common_ptr cinfo)
+{
+    ErrorManager* err = reinterpret_cast<ErrorManager*>(cinfo->err);
+    char msg[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, msg);
+    std::cerr << "libjpeg: " << msg << '\n';
+    std::longjmp(err->jump, 1);
+}
+
+// Orthonormal 8‑point DCT‑II basis, cos_table[u][x] = C(u)/2 · cos((2x+1)uπ/16)
+struct DctBasis {
+    float m[8][8];
+    DctBasis() {
+        const double pi = 3.14159265358979323846;
+        for (int u = 0; u < 8; ++u)
+            for (int x = 0; x < 8; ++x)
+                m[u][x] = static_cast<float>((u == 0 ? std::sqrt(0.125) : 0.5) *
+                                             std::cos((2 * x + 1) * u * pi / 16.0));
+    }
+};
+
+// Forward DCT of one level‑shifted 8×8 block; output is scaled by 8 like
+// libjpeg's own DCT so the quantiser divides by quantval << 3.
+inline void forward_dct(const float in[64], const DctBasis& b, JCOEF out[64])
+{
+    float tmp[64];
+    for (int y = 0; y < 8; ++y)           // rows
+        for (int u = 0; u < 8; ++u) {
+            float s = 0.0f;
+            for (int x = 0; x < 8; ++x) s += b.m[u][x] * in[y * 8 + x];
+            tmp[y * 8 + u] = s;
+        }
+    for (int u = 0; u < 8; ++u)           // columns
+        for (int v = 0; v < 8; ++v) {
+            float s = 0.0f;
+            for (int y = 0; y < 8; ++y) s += b.m[v][y] * tmp[y * 8 + u];
+            out[v * 8 + u] = static_cast<JCOEF>(std::lround(s * 8.0f));
+        }
+}
+
+// Same rounding as libjpeg's quantiser (jcdctmgr.c): round half away from zero
+inline JCOEF quantize(JCOEF coef, int divisor)
+{
+    int t = coef;
+    if (t < 0) {
+        t = -t + (divisor >> 1);
+        return static_cast<JCOEF>(-(t / divisor));
+    }
+    t += divisor >> 1;
+    return static_cast<JCOEF>(t / divisor);
+}
+
+// Quantiser divisors (quantval << 3, natural order) for Y and for Cb/Cr at
+// every quality 0..100, taken from libjpeg itself so they match the encoder
+// exactly. Built once per process; the screening loop then only quantises.
+struct QuantTables {
+    bool ok = false;
+    int divisor[101][2][DCTSIZE2];
+};
+
+inline QuantTables build_quant_tables()
+{
+    QuantTables t;
+    jpeg_compress_struct cinfo;
+    ErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = error_exit;
+    if (setjmp(jerr.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return t;
+    }
+
+    jpeg_create_compress(&cinfo);
+    cinfo.in_color_space = JCS_RGB;
+    cinfo.input_components = 3;
+    jpeg_set_defaults(&cinfo);
+    for (int q = 0; q <= 100; ++q) {
+        jpeg_set_quality(&cinfo, q, TRUE);
+        for (int c = 0; c < 2; ++c)
+            for (int i = 0; i < DCTSIZE2; ++i)
+                t.divisor[q][c][i] = cinfo.quant_tbl_ptrs[c]->quantval[i] << 3;
+    }
+    jpeg_destroy_compress(&cinfo);
+    t.ok = true;
+    return t;
+}
+
+// nullptr for qualities outside 0..100 or if libjpeg failed
+inline const int (*quant_divisors(int quality))[DCTSIZE2]
+{
+    static const QuantTables tables = build_quant_tables();
+    if (!tables.ok || quality < 0 || quality > 100) return nullptr;
+    return tables.divisor[quality];
+}
+
+// Variance of rounding a value to an integer (uniform error in [-0.5, 0.5))
+constexpr double kRoundingMSE = 1.0 / 12.0;
+
+} // namespace jpg_sweep_detail
+
+// ----------------------------------------------------------------------------
+// DCT‑domain distortion estimate for one quality level
+// ----------------------------------------------------------------------------
+struct JpegDistortionEstimate {
+    int quality;
+    double mse[3];      // Y, Cb, Cr quantisation error (per sample)
+    double mse_rgb;     // Mapped to RGB, averaged over the three channels
+    double psnr;        // psnrFromMSE(mse_rgb)
+};
+
+// ----------------------------------------------------------------------------
+// Prepared image for a multi‑quality JPEG sweep
+// Holds 4:4:4 BT.601 full‑range YCbCr DCT coefficients (×8, natural order),
+// the same colour setup tjCompress2 uses with TJSAMP_444.
+// ----------------------------------------------------------------------------
+class JpegDctSweep {
+public:
+    // rgb: interleaved 8‑bit RGB, width·3 bytes per row
+    JpegDctSweep(const unsigned char* rgb, int width, int height, int threads = 0)
+        : width_(width), height_(height),
+          blocks_w_((width + 7) / 8), blocks_h_((height + 7) / 8)
+    {
+        if (width <= 0 || height <= 0)
+            throw std::invalid_argument("empty image");
+
+        // 1) Colour conversion, once
+        std::vector<uint8_t> planes[3];
+        for (auto& p : planes) p.resize(size_t(width) * height);
+        const YCbCrPlanes out{planes[0].data(), width, planes[1].data(), width, planes[2].data(), width};
+        rgbToYCbCr(rgb, width, height, width * 3, out, ChromaFormat::C444,
+                   YCbCrMatrix::BT601, true, threads);
+
+        // 2) Forward DCT, once; block rows are split across threads
+        for (auto& c : coef_) c.resize(size_t(blocks_w_) * blocks_h_ * DCTSIZE2);
+
+        const jpg_sweep_detail::DctBasis basis;
+        auto transform_rows = [&](int by_begin, int by_end) {
+            float block[64];
+            for (int c = 0; c < 3; ++c)
+                for (int by = by_begin; by < by_end; ++by)
+                    for (int bx = 0; bx < blocks_w_; ++bx) {
+                        // Edge blocks replicate the last column / row, like libjpeg
+                        for (int y = 0; y < 8; ++y) {
+                            const int sy = std::min(by * 8 + y, height - 1);
+                            const uint8_t* row = planes[c].data() + size_t(sy) * width;
+                            for (int x = 0; x < 8; ++x)
+                                block[y * 8 + x] = float(row[std::min(bx * 8 + x, width - 1)]) - 128.0f;
+                        }
+                        jpg_sweep_detail::forward_dct(block, basis, block_ptr(c, bx, by));
+                    }
+        };
+
+        int n_threads = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+        n_threads = std::max(1, std::min(n_threads, blocks_h_ / 8));
+        std::vector<std::thread> workers;
+        const int rows_per_thread = (blocks_h_ + n_threads - 1) / n_threads;
+        for (int t = 1; t < n_threads; ++t) {
+            const int begin = t * rows_per_thread;
+            const int end = std::min(blocks_h_, begin + rows_per_thread);
+            if (begin < end) workers.emplace_back(transform_rows, begin, end);
+        }
+        transform_rows(0, std::min(blocks_h_, rows_per_thread));
+        for (std::thread& th : workers) th.join();
+    }
+
+    int getWidth() const { return width_; }
+    int getHeight() const { return height_; }
+
+    // Quantise with the tables of `quality` and entropy‑code to a JPEG file in memory
+    bool encode(int quality, std::vector<unsigned char>& jpeg) const
+    {
+        jpeg_compress_struct cinfo;
+        jpg_sweep_detail::ErrorManager jerr;
+        cinfo.err = jpeg_std_error(&jerr.pub);
+        jerr.pub.error_exit = jpg_sweep_detail::error_exit;
+
+        unsigned char* buf = nullptr;
+        unsigned long size = 0;
+        if (setjmp(jerr.jump)) {
+            jpeg_destroy_compress(&cinfo);
+            std::free(buf);
+            return false;
+        }
+
+        jpeg_create_compress(&cinfo);
+        jpeg_mem_dest(&cinfo, &buf, &size);
+
+        // Same parameters tjCompress2 derives for RGB input, TJSAMP_444
+        cinfo.image_width = static_cast<JDIMENSION>(width_);
+        cinfo.image_height = static_cast<JDIMENSION>(height_);
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        for (int c = 0; c < 3; ++c) {
+            cinfo.comp_info[c].h_samp_factor = 1;
+            cinfo.comp_info[c].v_samp_factor = 1;
+        }
+
+        jvirt_barray_ptr arrays[3];
+        for (int c = 0; c < 3; ++c)
+            arrays[c] = (*cinfo.mem->request_virt_barray)(
+                reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, TRUE,
+                static_cast<JDIMENSION>(blocks_w_), static_cast<JDIMENSION>(blocks_h_), 1);
+
+        // Writes the headers and realises the coefficient arrays
+        jpeg_write_coefficients(&cinfo, arrays);
+
+        for (int c = 0; c < 3; ++c) {
+            const JQUANT_TBL* table = cinfo.quant_tbl_ptrs[cinfo.comp_info[c].quant_tbl_no];
+            int divisor[DCTSIZE2];
+            for (int i = 0; i < DCTSIZE2; ++i) divisor[i] = table->quantval[i] << 3;
+
+            for (int by = 0; by < blocks_h_; ++by) {
+                JBLOCKARRAY row = (*cinfo.mem->access_virt_barray)(
+                    reinterpret_cast<j_common_ptr>(&cinfo), arrays[c],
+                    static_cast<JDIMENSION>(by), 1, TRUE);
+                for (int bx = 0; bx < blocks_w_; ++bx) {
+                    const JCOEF* src = block_ptr(c, bx, by);
+                    JCOEF* dst = row[0][bx];
+                    for (int i = 0; i < DCTSIZE2; ++i)
+                        dst[i] = jpg_sweep_detail::quantize(src[i], divisor[i]);
+                }
+            }
+        }
+
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+
+        jpeg.assign(buf, buf + size);
+        std::free(buf);
+        return true;
+    }
+
+    // Estimate the decoded error without encoding or decoding. The DCT is
+    // orthonormal, so by Parseval the squared quantisation error summed over a
+    // block's coefficients equals the squared pixel error of that block. Add
+    // the integer rounding of the YCbCr samples and of the RGB output, then map
+    // the component errors to RGB through the JFIF inverse matrix assuming they
+    // are uncorrelated. Not modelled: the decoder's fast IDCT (TJFLAG_FASTDCT,
+    // dominant near quality 100) and clipping to 0..255 (very low quality).
+    JpegDistortionEstimate estimate(int quality) const
+    {
+        using jpg_sweep_detail::kRoundingMSE;
+
+        JpegDistortionEstimate est{};
+        est.quality = quality;
+
+        const auto divisor = jpg_sweep_detail::quant_divisors(quality);
+        if (!divisor) {
+            est.mse_rgb = est.psnr = NAN;
+            return est;
+        }
+
+        const size_t n = coef_[0].size();
+        for (int c = 0; c < 3; ++c) {
+            const int* d = divisor[c == 0 ? 0 : 1];
+            const JCOEF* coef = coef_[c].data();
+            double sse = 0.0;  // in (×8)² units
+            for (size_t i = 0; i < n; i += DCTSIZE2) {
+                int64_t block = 0;
+                for (int k = 0; k < DCTSIZE2; ++k) {
+                    const int recon = jpg_sweep_detail::quantize(coef[i + k], d[k]) * d[k];
+                    const int err = coef[i + k] - recon;
+                    block += int64_t(err) * err;
+                }
+                sse += double(block);
+            }
+            est.mse[c] = sse / (64.0 * double(n)) + kRoundingMSE;
+        }
+
+        // R = Y + 1.402 Cr, G = Y − 0.344136 Cb − 0.714136 Cr, B = Y + 1.772 Cb
+        const double wcb = 0.344136 * 0.344136 + 1.772 * 1.772;
+        const double wcr = 1.402 * 1.402 + 0.714136 * 0.714136;
+        est.mse_rgb = (3.0 * est.mse[0] + wcb * est.mse[1] + wcr * est.mse[2]) / 3.0 + kRoundingMSE;
+        est.psnr = psnrFromMSE(est.mse_rgb);
+        return est;
+    }
+
+    // Lowest quality whose estimated PSNR reaches target_db (100 if none does).
+    // Bisection, about seven estimates instead of up to 99. The estimate rises
+    // with quality, except for small dips on smooth content (one coefficient's
+    // rounding error is not monotone in its step); there the result can be a
+    // few steps above the lowest passing quality, but always one whose
+    // estimate reaches the target.
+    int qualityForTargetPSNR(double target_db) const
+    {
+        int lo = 1, hi = 100;
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            if (estimate(mid).psnr >= target_db) hi = mid;
+            else lo = mid + 1;
+        }
+        return lo;
+    }
+
+private:
+    const JCOEF* block_ptr(int c, int bx, int by) const {
+        return coef_[c].data() + (size_t(by) * blocks_w_ + bx) * DCTSIZE2;
+    }
+    JCOEF* block_ptr(int c, int bx, int by) {
+        return coef_[c].data() + (size_t(by) * blocks_w_ + bx) * DCTSIZE2;
+    }
+
+    int width_, height_;
+    int blocks_w_, blocks_h_;
+    std::vector<JCOEF> coef_[3];  // Y, Cb, Cr
+};
+
+// ----------------------------------------------------------------------------
+// Drop‑in counterpart of JpegPSNRtoCSV using JpegDctSweep: same CSV columns,
+// same alpha handling, PSNR from a full tjDecompress2 of every output.
+// ----------------------------------------------------------------------------
+inline void JpegDctOncePSNRtoCSV(const std::string& imgPath,
+                                 const std::string& csvPath,
+                                 bool keepTempFiles = false,
+                                 const std::vector<int>& qualities = {0,5,10,20,30,40,50,60,70,80,90,100})
+{
+    if (qualities.empty())
+        throw std::invalid_argument("quality list is empty");
+
+    JpgEncoder reference(imgPath.c_str(), "dummy.jpg");  // output file unused
+    reference.applyAlphaMask();                          // fills reference.getData()
+    const unsigned char* refRGB = reference.getData();
+    const int w = reference.getWidth();
+    const int h = reference.getHeight();
+
+    const JpegDctSweep sweep(refRGB, w, h);
+
+    std::ofstream csv(csvPath, std::ios::trunc);
+    if (!csv) throw std::runtime_error("cannot open CSV for writing");
+    csv << "quality,psnr,size_bytes\n";
+    csv << std::fixed << std::setprecision(6);
+
+    size_t rows = 0;
+    std::vector<unsigned char> jpeg;
+    for (int q : qualities)
+    {
+        if (q < 0 || q > 100) {
+            std::cerr << "Skipping illegal quality " << q << '\n';
+            continue;
+        }
+
+        /* a) Quantise + entropy-code ----------------------------------- */
+        if (!sweep.encode(q, jpeg)) {
+            std::cerr << "Compression failed at quality " << q << '\n';
+            continue;
+        }
+
+        /* b) Decode ---------------------------------------------------- */
+        JpgDecoder dec("", "unused.png");
+        if (!dec.jpeg_decompress_buffer(jpeg.data(), static_cast<unsigned long>(jpeg.size()))) {
+            std::cerr << "Decompression failed at quality " << q << '\n';
+            continue;
+        }
+
+        /* c) PSNR + size ----------------------------------------------- */
+        const double psnr = computePSNR(refRGB, dec.getRGBData(), w, h);
+        csv << q << ',' << psnr << ',' << jpeg.size() << '\n';
+        ++rows;
+
+        /* d) Keep the JPEG if asked ------------------------------------ */
+        if (keepTempFiles) {
+            const std::string name = "_psnr_q" + std::to_string(q) + ".jpg";
+            std::ofstream out(name, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(jpeg.data()), std::streamsize(jpeg.size()));
+        }
+    }
+
+    std::cout << "Wrote " << rows << " rows to " << csvPath << '\n';
+}
+
+// ----------------------------------------------------------------------------
+// Pick the lowest quality whose estimate reaches target_db and encode it.
+// With verify = true that one point is decoded and measured; meets_target
+// tells whether the real PSNR holds. No other quality is encoded or decoded.
+// ----------------------------------------------------------------------------
+struct JpegQualityChoice {
+    int quality = -1;           // -1 on encoder / decoder failure
+    double est_psnr = 0.0;      // Estimate for the chosen quality
+    double psnr = NAN;          // Decoded PSNR, NAN without verify
+    bool meets_target = false;  // psnr >= target (only set with verify)
+    size_t size_bytes = 0;
+    int decodes = 0;            // Full decodes spent (0 or 1)
+};
+
+inline JpegQualityChoice chooseJpegQuality(const JpegDctSweep& sweep, const unsigned char* rgb,
+                                           double target_db, std::vector<unsigned char>* jpeg_out = nullptr,
+                                           bool verify = true)
+{
+    JpegQualityChoice choice;
+    const int q = sweep.qualityForTargetPSNR(target_db);
+    choice.est_psnr = sweep.estimate(q).psnr;
+
+    std::vector<unsigned char> jpeg;
+    if (!sweep.encode(q, jpeg)) return choice;
+
+    if (verify) {
+        JpgDecoder dec("", "unused.png");
+        if (!dec.jpeg_decompress_buffer(jpeg.data(), static_cast<unsigned long>(jpeg.size()))) return choice;
+        choice.decodes = 1;
+        choice.psnr = computePSNR(rgb, dec.getRGBData(), sweep.getWidth(), sweep.getHeight());
+        choice.meets_target = choice.psnr >= target_db;
+    }
+
+    choice.quality = q;
+    choice.size_bytes = jpeg.size();
+    if (jpeg_out) jpeg_out->swap(jpeg);
+    return choice;
+}
+
+// ----------------------------------------------------------------------------
+// Screening sweep: DCT‑domain PSNR estimate per quality, no encode / decode.
+// With verify = true every point is also encoded, decoded with tjDecompress2
+// and measured with computePSNR, and the deviation of the estimate is written
+// next to it and summarised on stdout.
+// ----------------------------------------------------------------------------
+inline void JpegEstimatePSNRtoCSV(const std::string& imgPath,
+                                  const std::string& csvPath,
+                                  bool verify = false,
+                                  const std::vector<int>& qualities = {0,5,10,20,30,40,50,60,70,80,90,100})
+{
+    if (qualities.empty())
+        throw std::invalid_argument("quality list is empty");
+
+    JpgEncoder reference(imgPath.c_str(), "dummy.jpg");  // output file unused
+    reference.applyAlphaMask();
+    const unsigned char* refRGB = reference.getData();
+    const int w = reference.getWidth();
+    const int h = reference.getHeight();
+
+    const JpegDctSweep sweep(refRGB, w, h);
+
+    std::ofstream csv(csvPath, std::ios::trunc);
+    if (!csv) throw std::runtime_error("cannot open CSV for writing");
+    csv << "quality,est_psnr,est_mse_y,est_mse_cb,est_mse_cr";
+    if (verify) csv << ",psnr,size_bytes,deviation_db";
+    csv << '\n' << std::fixed << std::setprecision(6);
+
+    double max_dev = 0.0, sum_dev = 0.0;
+    int verified = 0;
+    std::vector<unsigned char> jpeg;
+    for (int q : qualities)
+    {
+        if (q < 0 || q > 100) {
+            std::cerr << "Skipping illegal quality " << q << '\n';
+            continue;
+        }
+
+        const JpegDistortionEstimate est = sweep.estimate(q);
+        csv << q << ',' << est.psnr << ',' << est.mse[0] << ',' << est.mse[1] << ',' << est.mse[2];
+
+        if (verify) {
+            JpgDecoder dec("", "unused.png");
+            if (sweep.encode(q, jpeg) &&
+                dec.jpeg_decompress_buffer(jpeg.data(), static_cast<unsigned long>(jpeg.size()))) {
+                const double psnr = computePSNR(refRGB, dec.getRGBData(), w, h);
+                const double dev = est.psnr - psnr;
+                csv << ',' << psnr << ',' << jpeg.size() << ',' << dev;
+                max_dev = std::max(max_dev, std::abs(dev));
+                sum_dev += std::abs(dev);
+                ++verified;
+            } else {
+                csv << ",,,";
+            }
+        }
+        csv << '\n';
+    }
+
+    std::cout << "Wrote estimates to " << csvPath << '\n';
+    if (verified)
+        std::cout << "Estimate vs. decoded PSNR: mean |dev| " << sum_dev / verified
+                  << " dB, max |dev| " << max_dev << " dB over " << verified << " points\n";
+}
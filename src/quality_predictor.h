@@ -0,0 +1,525 @@
+// quality_predictor.h – header‑only encode‑free quality prediction from image
+// complexity features, calibrated on earlier sweep results
+
+#ifndef QUALITY_PREDICTOR_H
+#define QUALITY_PREDICTOR_H
+
+#include "heic.h"                // HeicEncoder / HeicDecoder
+#include "jpg_sweep.h"           // JpegDctSweep, JpgEncoder (alpha mask) / JpgDecoder
+#include "helpers.h"             // computePSNR
+#include "results_log.h"         // ResultsLog::readAll for calibration
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// Encoder paths a model can be calibrated for. A model only fits files made
+// by the path it was calibrated on, so calibration and encodeAtTarget() use
+// the same encoder per name:
+//   "jpeg-dct"    JpegDctSweep (float DCT)           runCorpusSweep, WatchDaemon, JpegDctOncePSNRtoCSV
+//   "heic-ycbcr"  own YCbCr 4:2:0 + x265             runCorpusSweep, WatchDaemon, evaluateHeicSharedSourceSweep
+//   "jpeg-tj"     tjCompress2 with TJFLAG_FASTDCT    JpegPSNRtoCSV
+//   "heic-rgb"    libheif's RGB → YCbCr + x265       evaluateHeicQualitySweep
+// The first two are the corpus / watch row codecs (isCorpusCodec).
+// ----------------------------------------------------------------------------
+inline bool isPredictorCodec(const std::string& codec)
+{
+    return codec == "jpeg-dct" || codec == "heic-ycbcr" || codec == "jpeg-tj" || codec == "heic-rgb";
+}
+
+inline bool isJpegPath(const std::string& codec) { return codec.compare(0, 4, "jpeg") == 0; }
+
+// ----------------------------------------------------------------------------
+// Complexity features of an interleaved RGB image, all per pixel
+// ----------------------------------------------------------------------------
+struct ComplexityFeatures {
+    double gradient_energy = 0.0;   // Mean squared horizontal + vertical luma difference
+    double block_variance = 0.0;    // Mean luma variance of the 8×8 blocks (= AC energy of their DCT / 64)
+    double chroma_activity = 0.0;   // Mean squared Cb / Cr difference, horizontal + vertical
+};
+
+// ----------------------------------------------------------------------------
+// One pass over the image, two rows of integer Y / Cb / Cr at a time; the
+// inner loops are plain array arithmetic so the compiler vectorises them.
+// ----------------------------------------------------------------------------
+inline ComplexityFeatures computeComplexityFeatures(const unsigned char* rgb, int width, int height)
+{
+    ComplexityFeatures f;
+    if (width < 2 || height < 2) return f;
+
+    const int bw = width / 8;                     // complete 8×8 blocks per row
+    std::vector<int32_t> y[2], cb[2], cr[2];
+    for (int i = 0; i < 2; ++i) {
+        y[i].resize(width);
+        cb[i].resize(width);
+        cr[i].resize(width);
+    }
+    std::vector<int64_t> block_sum(bw), block_sq(bw);
+
+    double grad = 0.0, chroma = 0.0, block_var = 0.0;
+    for (int row = 0; row < height; ++row) {
+        const int cur = row & 1, prev = cur ^ 1;
+        int32_t* Y = y[cur].data();
+        int32_t* Cb = cb[cur].data();
+        int32_t* Cr = cr[cur].data();
+        const unsigned char* px = rgb + size_t(row) * width * 3;
+
+        // JFIF matrix in 8.8 fixed point, offsets dropped (only differences matter)
+        for (int x = 0; x < width; ++x) {
+            const int32_t r = px[3 * x], g = px[3 * x + 1], b = px[3 * x + 2];
+            Y[x]  = (77 * r + 150 * g + 29 * b) >> 8;
+            Cb[x] = (-43 * r - 85 * g + 128 * b) >> 8;
+            Cr[x] = (128 * r - 107 * g - 21 * b) >> 8;
+        }
+
+        // Horizontal differences
+        int64_t gy = 0, gc = 0;
+        for (int x = 0; x + 1 < width; ++x) {
+            const int32_t dy = Y[x + 1] - Y[x], db = Cb[x + 1] - Cb[x], dr = Cr[x + 1] - Cr[x];
+            gy += dy * dy;
+            gc += db * db + dr * dr;
+        }
+
+        // Vertical differences against the previous row
+        if (row > 0) {
+            const int32_t* Yp = y[prev].data();
+            const int32_t* Cbp = cb[prev].data();
+            const int32_t* Crp = cr[prev].data();
+            for (int x = 0; x < width; ++x) {
+                const int32_t dy = Y[x] - Yp[x], db = Cb[x] - Cbp[x], dr = Cr[x] - Crp[x];
+                gy += dy * dy;
+                gc += db * db + dr * dr;
+            }
+        }
+        grad += double(gy);
+        chroma += double(gc);
+
+        // 8×8 block statistics, finished every eighth row
+        if (row < height / 8 * 8) {
+            for (int b = 0; b < bw; ++b) {
+                int64_t s = 0, s2 = 0;
+                for (int x = b * 8; x < b * 8 + 8; ++x) {
+                    s += Y[x];
+                    s2 += Y[x] * Y[x];
+                }
+                block_sum[b] += s;
+                block_sq[b] += s2;
+            }
+            if (row % 8 == 7) {
+                for (int b = 0; b < bw; ++b) {
+                    const double mean = double(block_sum[b]) / 64.0;
+                    block_var += double(block_sq[b]) / 64.0 - mean * mean;
+                    block_sum[b] = block_sq[b] = 0;
+                }
+            }
+        }
+    }
+
+    const double pixels = double(width) * height;
+    f.gradient_energy = grad / pixels;
+    f.chroma_activity = chroma / pixels;
+    const double blocks = double(bw) * (height / 8);
+    f.block_variance = blocks > 0 ? block_var / blocks : 0.0;
+    return f;
+}
+
+// ----------------------------------------------------------------------------
+// Per codec and quality level, PSNR is modelled as a linear function of the
+// log features:  psnr ≈ w0 + w1·ln(1+g) + w2·ln(1+v) + w3·ln(1+c)
+// The weights are fitted (ridge least squares) on the quality levels seen in
+// past sweeps. Prediction evaluates the model on that quality grid, makes the
+// curve monotone and interpolates the lowest quality that reaches the target.
+// ----------------------------------------------------------------------------
+class QualityPredictor {
+public:
+    using Weights = std::array<double, 4>;
+
+    // Add one measured point; false if it was skipped
+    bool addSample(const std::string& codec, const ComplexityFeatures& f, int quality, double psnr)
+    {
+        if (!std::isfinite(psnr)) return false;    // lossless points carry no slope information
+        samples_[{codec, quality}].push_back({regressors(f), psnr});
+        return true;
+    }
+
+    // Calibrate from a ResultsLog (CSV or .rlog); features are computed once
+    // per image, loaded the same way the sweeps load it. Returns the number of
+    // samples added.
+    size_t addResultsLog(const std::string& path)
+    {
+        std::vector<ResultsRow> rows;
+        if (!ResultsLog::readAll(path, ResultsLog::formatForPath(path), rows)) return 0;
+
+        std::map<std::pair<std::string, std::string>, ComplexityFeatures> cache;
+        size_t added = 0;
+        for (const ResultsRow& r : rows) {
+            if (!isPredictorCodec(r.codec)) continue;
+            auto key = std::make_pair(r.image, r.codec);
+            auto it = cache.find(key);
+            if (it == cache.end()) {
+                ComplexityFeatures f;
+                if (!featuresForImage(r.image, r.codec, f)) continue;
+                it = cache.emplace(key, f).first;
+            }
+            added += addSample(r.codec, it->second, r.quality, r.psnr);
+        }
+        return added;
+    }
+
+    // Calibrate from a single‑image sweep CSV ("quality,psnr,size_bytes",
+    // optionally followed by comparison columns); codec names the encoder path
+    // the sweep used (see isPredictorCodec). Other CSVs, e.g. the estimates of
+    // JpegEstimatePSNRtoCSV ("quality,est_psnr,..."), are not measurements and
+    // add nothing.
+    size_t addSweepCSV(const std::string& image_path, const std::string& csv_path, const std::string& codec)
+    {
+        static const std::string kHeader = "quality,psnr,size_bytes";
+        std::ifstream csv(csv_path);
+        std::string line;
+        if (!isPredictorCodec(codec) || !csv || !std::getline(csv, line)) return 0;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.compare(0, kHeader.size(), kHeader) != 0 || (line.size() > kHeader.size() && line[kHeader.size()] != ','))
+            return 0;
+
+        ComplexityFeatures f;
+        if (!featuresForImage(image_path, codec, f)) return 0;
+        size_t added = 0;
+        while (std::getline(csv, line)) {
+            std::istringstream ss(line);
+            std::string q, psnr;
+            if (!std::getline(ss, q, ',') || !std::getline(ss, psnr, ',')) continue;
+            try {
+                added += addSample(codec, f, std::stoi(q), std::stod(psnr));
+            } catch (const std::exception&) {
+                continue;                         // malformed row
+            }
+        }
+        return added;
+    }
+
+    // Fit every (codec, quality) with at least min_samples points
+    void fit(size_t min_samples = 5, double ridge = 1e-3)
+    {
+        models_.clear();
+        for (const auto& [key, pts] : samples_) {
+            if (pts.size() < min_samples) continue;
+
+            // Normal equations (XᵀX + λI) w = Xᵀy, solved by Gaussian elimination
+            double a[4][5] = {};
+            for (const Sample& s : pts)
+                for (int i = 0; i < 4; ++i) {
+                    for (int j = 0; j < 4; ++j) a[i][j] += s.x[i] * s.x[j];
+                    a[i][4] += s.x[i] * s.psnr;
+                }
+            for (int i = 1; i < 4; ++i) a[i][i] += ridge * double(pts.size());
+
+            for (int c = 0; c < 4; ++c) {
+                int piv = c;
+                for (int r = c + 1; r < 4; ++r)
+                    if (std::abs(a[r][c]) > std::abs(a[piv][c])) piv = r;
+                std::swap(a[c], a[piv]);
+                if (std::abs(a[c][c]) < 1e-12) break;
+                for (int r = 0; r < 4; ++r) {
+                    if (r == c) continue;
+                    const double k = a[r][c] / a[c][c];
+                    for (int j = c; j < 5; ++j) a[r][j] -= k * a[c][j];
+                }
+            }
+            Weights w{};
+            bool ok = true;
+            for (int i = 0; i < 4; ++i) {
+                ok = ok && std::abs(a[i][i]) >= 1e-12;
+                w[i] = ok ? a[i][4] / a[i][i] : 0.0;
+            }
+            if (ok) models_[key.first][key.second] = w;
+        }
+    }
+
+    bool hasModel(const std::string& codec) const { return models_.count(codec) != 0; }
+
+    // Codecs with at least one fitted quality level
+    std::vector<std::string> codecs() const
+    {
+        std::vector<std::string> out;
+        for (const auto& [codec, grid] : models_) out.push_back(codec);
+        return out;
+    }
+
+    // Modelled PSNR curve over the calibrated quality grid (monotone)
+    std::vector<std::pair<int, double>> predictCurve(const std::string& codec, const ComplexityFeatures& f) const
+    {
+        std::vector<std::pair<int, double>> curve;
+        const auto it = models_.find(codec);
+        if (it == models_.end()) return curve;
+
+        const std::array<double, 4> x = regressors(f);
+        double best = -INFINITY;
+        for (const auto& [q, w] : it->second) {
+            double p = 0.0;
+            for (int i = 0; i < 4; ++i) p += w[i] * x[i];
+            best = std::max(best, p);              // PSNR never drops with quality
+            curve.emplace_back(q, best);
+        }
+        return curve;
+    }
+
+    // Lowest quality whose predicted PSNR reaches target_db; -1 without model
+    int predictQuality(const std::string& codec, const ComplexityFeatures& f, double target_db) const
+    {
+        const std::vector<std::pair<int, double>> curve = predictCurve(codec, f);
+        if (curve.empty()) return -1;
+        if (curve.front().second >= target_db) return curve.front().first;
+
+        for (size_t i = 1; i < curve.size(); ++i) {
+            const auto& [q0, p0] = curve[i - 1];
+            const auto& [q1, p1] = curve[i];
+            if (p1 >= target_db) {
+                const double t = p1 > p0 ? (target_db - p0) / (p1 - p0) : 1.0;
+                return std::clamp(int(std::ceil(q0 + t * (q1 - q0))), q0, q1);
+            }
+        }
+        return curve.back().first;
+    }
+
+    // Predicted PSNR at any quality (linear between grid points)
+    double predictPSNR(const std::string& codec, const ComplexityFeatures& f, int quality) const
+    {
+        const std::vector<std::pair<int, double>> curve = predictCurve(codec, f);
+        if (curve.empty()) return NAN;
+        if (quality <= curve.front().first) return curve.front().second;
+        for (size_t i = 1; i < curve.size(); ++i)
+            if (quality <= curve[i].first) {
+                const auto& [q0, p0] = curve[i - 1];
+                const auto& [q1, p1] = curve[i];
+                return p0 + (p1 - p0) * double(quality - q0) / double(q1 - q0);
+            }
+        return curve.back().second;
+    }
+
+    // Model file: "codec,quality,w0,w1,w2,w3" per line
+    bool save(const std::string& path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) return false;
+        out << "codec,quality,w0,w1,w2,w3\n" << std::setprecision(10);
+        for (const auto& [codec, grid] : models_)
+            for (const auto& [q, w] : grid)
+                out << codec << ',' << q << ',' << w[0] << ',' << w[1] << ',' << w[2] << ',' << w[3] << '\n';
+        return bool(out);
+    }
+
+    // Any malformed line rejects the whole file and leaves no model loaded
+    bool load(const std::string& path)
+    {
+        models_.clear();
+        std::ifstream in(path);
+        std::string line;
+        if (!in || !std::getline(in, line) || line.rfind("codec,quality,w0,w1,w2,w3", 0) != 0) return false;
+
+        std::map<std::string, std::map<int, Weights>> models;
+        while (std::getline(in, line)) {
+            std::istringstream ss(line);
+            std::string codec, field;
+            Weights w{};
+            int q = 0;
+            if (!std::getline(ss, codec, ',') || !std::getline(ss, field, ',')) return false;
+            try {
+                q = std::stoi(field);
+                for (double& v : w) {
+                    if (!std::getline(ss, field, ',')) return false;
+                    v = std::stod(field);
+                }
+            } catch (const std::exception&) {
+                return false;                     // not a model file
+            }
+            models[codec][q] = w;
+        }
+        models_ = std::move(models);
+        return true;
+    }
+
+    // Load an image the way the sweeps of that codec do (JPEG: alpha
+    // composited on white, HEIC: alpha dropped) and compute its features
+    static bool featuresForImage(const std::string& path, const std::string& codec, ComplexityFeatures& f)
+    {
+        if (isJpegPath(codec)) {
+            try {
+                JpgEncoder src(path.c_str(), "unused.jpg");
+                src.applyAlphaMask();
+                f = computeComplexityFeatures(src.getData(), src.getWidth(), src.getHeight());
+                return true;
+            } catch (...) {
+                return false;
+            }
+        }
+        int w, h, comp;
+        unsigned char* rgb = stbi_load(path.c_str(), &w, &h, &comp, 3);
+        if (!rgb) return false;
+        f = computeComplexityFeatures(rgb, w, h);
+        stbi_image_free(rgb);
+        return true;
+    }
+
+private:
+    struct Sample {
+        std::array<double, 4> x;
+        double psnr;
+    };
+
+    static std::array<double, 4> regressors(const ComplexityFeatures& f)
+    {
+        return {1.0, std::log1p(f.gradient_energy), std::log1p(f.block_variance), std::log1p(f.chroma_activity)};
+    }
+
+    std::map<std::pair<std::string, int>, std::vector<Sample>> samples_;
+    std::map<std::string, std::map<int, Weights>> models_;   // codec → quality → weights
+};
+
+// ----------------------------------------------------------------------------
+// Encode once at the predicted quality, verify by decoding and, if allowed
+// and the target is missed, make one correction along the model's slope.
+// ----------------------------------------------------------------------------
+struct PredictedEncodeResult {
+    int predicted_quality = -1;     // From the features alone
+    int quality = -1;               // Quality of the file that was kept
+    double psnr = NAN;              // Measured after decoding; NAN = failed, INFINITY = lossless
+    std::uintmax_t size_bytes = 0;
+    int encodes = 0;                // 1, or 2 with a correction
+};
+
+namespace quality_predictor_detail {
+
+// Second quality for a missed target: step along the predicted curve
+inline int corrected_quality(const QualityPredictor& model, const std::string& codec,
+                             const ComplexityFeatures& f, int q, double psnr, double target_db)
+{
+    const int dir = psnr < target_db ? 1 : -1;
+    const int q2 = std::clamp(q + dir * 5, 0, 100);
+    if (q2 == q) return q;                        // already at the end of the range
+    const double slope = (model.predictPSNR(codec, f, q2) - model.predictPSNR(codec, f, q)) / double(q2 - q);
+    if (!(slope > 0.01)) return q2;               // flat model: fixed step
+    return std::clamp(q + int(std::ceil((target_db - psnr) / slope)), 0, 100);
+}
+
+} // namespace quality_predictor_detail
+
+// Encode in_path with the encoder path named by codec (see isPredictorCodec),
+// at the quality the model predicts for target_db. With correct = true a
+// second encode is made only if the first one misses the target. The kept
+// file is written to out_path.
+inline PredictedEncodeResult encodeAtTarget(const std::string& in_path, const std::string& out_path,
+                                            const QualityPredictor& model, const std::string& codec,
+                                            double target_db, bool correct = true)
+{
+    PredictedEncodeResult res;
+    if (!isPredictorCodec(codec)) return res;
+
+    // Reference pixels, loaded like the sweeps of that path load them
+    std::unique_ptr<JpgEncoder> jpeg_src;
+    std::vector<unsigned char> rgb;
+    int w = 0, h = 0;
+    if (isJpegPath(codec)) {
+        try {
+            jpeg_src = std::make_unique<JpgEncoder>(in_path.c_str(), out_path.c_str());
+        } catch (...) {
+            return res;
+        }
+        jpeg_src->applyAlphaMask();
+        w = jpeg_src->getWidth();
+        h = jpeg_src->getHeight();
+        rgb.assign(jpeg_src->getData(), jpeg_src->getData() + size_t(w) * h * 3);
+    } else {
+        int comp;
+        unsigned char* data = stbi_load(in_path.c_str(), &w, &h, &comp, 3);
+        if (!data) return res;
+        rgb.assign(data, data + size_t(w) * h * 3);
+        stbi_image_free(data);
+    }
+    const ComplexityFeatures f = computeComplexityFeatures(rgb.data(), w, h);
+
+    res.predicted_quality = model.predictQuality(codec, f, target_db);
+    if (res.predicted_quality < 0) return res;
+
+    // Per-image preparation of the encoder path, done once for both encodes
+    std::unique_ptr<JpegDctSweep> sweep;
+    heif_image* heif_source = nullptr;
+    if (codec == "jpeg-dct")
+        sweep = std::make_unique<JpegDctSweep>(rgb.data(), w, h);
+    else if (codec == "heic-ycbcr")
+        heif_source = HeicEncoder::make_ycbcr_image(rgb.data(), w, h);
+    else if (codec == "heic-rgb")
+        heif_source = HeicEncoder::make_rgb_image(rgb.data(), w, h);
+    if (!isJpegPath(codec) && !heif_source) return res;
+
+    std::vector<uint8_t> bytes, decoded;
+    auto encode = [&](int q) -> double {
+        ++res.encodes;
+        bool ok;
+        if (codec == "jpeg-dct") {
+            std::vector<unsigned char> jpeg;
+            ok = sweep->encode(q, jpeg);
+            bytes.assign(jpeg.begin(), jpeg.end());
+        } else if (codec == "jpeg-tj") {
+            // tjCompress2 + FASTDCT as in JpegPSNRtoCSV; writes out_path
+            std::ifstream in;
+            ok = jpeg_src->jpeg_compress(q);
+            if (ok) in.open(out_path, std::ios::binary);
+            ok = ok && in;
+            if (ok) bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        } else {
+            const HeicYCbCrOptions ycbcr;   // as make_ycbcr_image above
+            ok = codec == "heic-ycbcr" ? HeicEncoder::encode_to_memory(heif_source, q, bytes,
+                                                                       HeicEncoder::chroma_param(ycbcr.chroma),
+                                                                       HeicEncoder::ycbcr_params(ycbcr))
+                                       : HeicEncoder::encode_to_memory(heif_source, q, bytes);
+        }
+        if (!ok) return NAN;
+
+        int dw = 0, dh = 0;
+        if (isJpegPath(codec)) {
+            JpgDecoder dec("", "unused.png");
+            if (!dec.jpeg_decompress_buffer(bytes.data(), static_cast<unsigned long>(bytes.size()))) return NAN;
+            dw = dec.getWidth();
+            dh = dec.getHeight();
+            if (dw != w || dh != h) return NAN;
+            return computePSNR(rgb.data(), dec.getRGBData(), w, h);
+        }
+        if (!HeicDecoder::decode_memory_to_rgb(bytes.data(), bytes.size(), decoded, dw, dh) || dw != w || dh != h)
+            return NAN;
+        return computePSNR(rgb.data(), decoded.data(), w, h);
+    };
+
+    res.quality = res.predicted_quality;
+    res.psnr = encode(res.quality);
+    if (correct && !std::isnan(res.psnr) && res.psnr < target_db) {
+        const int q2 = quality_predictor_detail::corrected_quality(model, codec, f, res.quality, res.psnr, target_db);
+        if (q2 != res.quality) {
+            res.quality = q2;
+            res.psnr = encode(q2);
+        }
+    }
+    if (heif_source) heif_image_release(heif_source);
+
+    if (!std::isnan(res.psnr)) {                  // a lossless result (INFINITY) is kept too
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+        out.close();
+        if (!out) res.psnr = NAN;                 // reported as a failed encode
+        res.size_bytes = bytes.size();
+    }
+    return res;
+}
+
+#endif // QUALITY_PREDICTOR_H
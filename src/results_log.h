@@ -0,0 +1,432 @@
+// results_log.h – header‑only append‑only results log (CSV or columnar binary)
+// with batched flush / fsync and resume of interrupted corpus runs
+
+#ifndef RESULTS_LOG_H
+#define RESULTS_LOG_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>                  // _commit / _fileno
+#else
+#include <unistd.h>              // fsync
+#endif
+
+// ----------------------------------------------------------------------------
+// One measured point of a sweep
+// ----------------------------------------------------------------------------
+struct ResultsRow {
+    std::string image;           // Source image path
+    std::string codec;           // "jpeg-dct", "heic-ycbcr", ... (isCorpusCodec)
+    int quality = 0;
+    double psnr = 0.0;           // dB
+    uint64_t size_bytes = 0;
+};
+
+enum class ResultsFormat { CSV, Columnar };
+
+struct ResultsLogOptions {
+    size_t batch_rows = 64;      // Rows buffered before they are written out
+    int sync_every = 4;          // fsync after every n‑th write‑out (0 = only on close)
+};
+
+namespace results_log_detail {
+
+inline uint32_t crc32(const uint8_t* data, size_t size)
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// 32 / 64 bit fields, little endian on every host
+template <typename T>
+using Bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+template <typename T>
+inline void put(std::vector<uint8_t>& out, const T& v)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "32 or 64 bit fields only");
+    Bits<T> bits;
+    std::memcpy(&bits, &v, sizeof(T));
+    for (size_t i = 0; i < sizeof(T); ++i) out.push_back(uint8_t(bits >> (8 * i)));
+}
+
+template <typename T>
+inline bool get(const uint8_t*& p, const uint8_t* end, T& v)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "32 or 64 bit fields only");
+    if (size_t(end - p) < sizeof(T)) return false;
+    Bits<T> bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) bits |= Bits<T>(p[i]) << (8 * i);
+    std::memcpy(&v, &bits, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+// String column: int32 offsets[n + 1] followed by the concatenated bytes
+inline void put_strings(std::vector<uint8_t>& out, const std::vector<ResultsRow>& rows,
+                        std::string ResultsRow::*field)
+{
+    int32_t offset = 0;
+    put(out, offset);
+    for (const ResultsRow& r : rows) {
+        offset += static_cast<int32_t>((r.*field).size());
+        put(out, offset);
+    }
+    for (const ResultsRow& r : rows)
+        out.insert(out.end(), (r.*field).begin(), (r.*field).end());
+}
+
+inline bool get_strings(const uint8_t*& p, const uint8_t* end, std::vector<ResultsRow>& rows,
+                        std::string ResultsRow::*field)
+{
+    std::vector<int32_t> offsets(rows.size() + 1);
+    for (int32_t& o : offsets)
+        if (!get(p, end, o)) return false;
+    if (offsets.front() != 0 || offsets.back() < 0 || size_t(end - p) < size_t(offsets.back())) return false;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (offsets[i + 1] < offsets[i]) return false;
+        (rows[i].*field).assign(reinterpret_cast<const char*>(p) + offsets[i], size_t(offsets[i + 1] - offsets[i]));
+    }
+    p += offsets.back();
+    return true;
+}
+
+// CSV field, quoted when it contains a separator, quote or line break
+inline void put_csv_field(std::string& out, const std::string& s)
+{
+    if (s.find_first_of(",\"\r\n") == std::string::npos) {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+inline std::vector<std::string> split_csv_line(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') { fields.back() += '"'; ++i; }
+            else if (c == '"') quoted = false;
+            else fields.back() += c;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+constexpr char kCsvHeader[] = "image,codec,quality,psnr,size_bytes\n";
+constexpr char kMagic[4] = {'R', 'L', 'G', '2'};
+// Payload bytes per row without string bytes (two offsets, quality, psnr,
+// size); a batch adds the two leading offsets, 8 bytes
+constexpr size_t kMinRowBytes = 2 * 4 + 4 + 8 + 8;
+
+} // namespace results_log_detail
+
+// ----------------------------------------------------------------------------
+// Append‑only results log
+//
+// Rows are buffered and written in batches of opts.batch_rows; every
+// opts.sync_every‑th batch is also fsync'ed, so a crash loses at most the
+// unsynced tail. Opening an existing log resumes it: complete rows are kept
+// (contains() reports them), a torn last line / batch is cut off, and new rows
+// are appended behind them. Images are identified by their weakly canonical
+// path, so "./a.png" and "/abs/a.png" are the same point; rows keep the path
+// as it was given.
+//
+// CSV:      "image,codec,quality,psnr,size_bytes" header, one row per line.
+//           A complete line that does not parse is skipped (skippedLines()),
+//           only an unterminated last line is cut off.
+// Columnar: "RLG2", then one record batch per write‑out:
+//             uint32 rows, uint32 payload bytes, payload,
+//             uint32 CRC‑32 of rows, payload bytes and payload;
+//             payload = image strings, codec strings (int32 offsets[rows + 1]
+//             + bytes), int32 quality[rows], float64 psnr[rows],
+//             uint64 size_bytes[rows]; all little endian.
+//
+// Not thread‑safe; use one writer thread.
+// ----------------------------------------------------------------------------
+class ResultsLog {
+public:
+    ResultsLog(const std::string& path, ResultsFormat format, ResultsLogOptions opts = {})
+        : path_(path), format_(format), opts_(opts)
+    {
+        std::vector<ResultsRow> existing;
+        uint64_t valid_bytes = 0;
+        const bool exists = std::filesystem::exists(path_);
+        if (exists && !scan(path_, format_, existing, valid_bytes, skipped_))
+            throw std::runtime_error("not a results log: " + path_);
+
+        if (exists) {
+            // Drop a torn tail left by an interrupted run
+            std::error_code ec;
+            if (std::filesystem::file_size(path_, ec) != valid_bytes)
+                std::filesystem::resize_file(path_, valid_bytes, ec);
+            // Rows of one image are adjacent, normalise each path once
+            std::string raw, image;
+            for (const ResultsRow& r : existing) {
+                if (r.image != raw) image = normalise(raw = r.image);
+                done_.insert(key(image, r.codec, r.quality));
+            }
+            resumed_ = existing.size();
+        }
+
+        file_ = std::fopen(path_.c_str(), exists && valid_bytes > 0 ? "ab" : "wb");
+        if (!file_) throw std::runtime_error("cannot open results log: " + path_);
+
+        if (!exists || valid_bytes == 0) {
+            if (format_ == ResultsFormat::CSV)
+                std::fwrite(results_log_detail::kCsvHeader, 1, std::strlen(results_log_detail::kCsvHeader), file_);
+            else
+                std::fwrite(results_log_detail::kMagic, 1, 4, file_);
+            std::fflush(file_);
+        }
+    }
+
+    ~ResultsLog()
+    {
+        flush(true);
+        std::fclose(file_);
+    }
+
+    ResultsLog(const ResultsLog&) = delete;
+    ResultsLog& operator=(const ResultsLog&) = delete;
+
+    // Format by extension: ".rlog" is columnar, everything else CSV
+    static ResultsFormat formatForPath(const std::string& path)
+    {
+        return std::filesystem::path(path).extension() == ".rlog" ? ResultsFormat::Columnar : ResultsFormat::CSV;
+    }
+
+    // True if the row was written before (this run or a resumed one)
+    bool contains(const std::string& image, const std::string& codec, int quality) const
+    {
+        return done_.count(key(normalise(image), codec, quality)) != 0;
+    }
+
+    size_t resumedRows() const { return resumed_; }
+    size_t writtenRows() const { return written_; }
+    size_t skippedLines() const { return skipped_; }   // Unparsable CSV lines found when opening
+
+    void append(ResultsRow row)
+    {
+        done_.insert(key(normalise(row.image), row.codec, row.quality));
+        pending_.push_back(std::move(row));
+        if (pending_.size() >= opts_.batch_rows) flush(false);
+    }
+
+    // Write out pending rows; sync forces an fsync even between sync_every
+    bool flush(bool sync)
+    {
+        bool ok = true;
+        if (!pending_.empty()) {
+            const std::vector<uint8_t> bytes = format_ == ResultsFormat::CSV ? encode_csv(pending_)
+                                                                           : encode_batch(pending_);
+            ok = std::fwrite(bytes.data(), 1, bytes.size(), file_) == bytes.size();
+            ok = std::fflush(file_) == 0 && ok;
+            written_ += pending_.size();
+            pending_.clear();
+            ++unsynced_;
+        }
+        if (unsynced_ && (sync || (opts_.sync_every > 0 && unsynced_ >= opts_.sync_every))) {
+#ifdef _WIN32
+            ok = _commit(_fileno(file_)) == 0 && ok;
+#else
+            ok = fsync(fileno(file_)) == 0 && ok;
+#endif
+            unsynced_ = 0;
+        }
+        return ok;
+    }
+
+    // Read every complete row of a log
+    static bool readAll(const std::string& path, ResultsFormat format, std::vector<ResultsRow>& rows)
+    {
+        uint64_t valid_bytes = 0;
+        size_t skipped = 0;
+        rows.clear();
+        return scan(path, format, rows, valid_bytes, skipped);
+    }
+
+private:
+    static std::string normalise(const std::string& image)
+    {
+        // absolute() first: without an existing prefix weakly_canonical()
+        // leaves a relative path relative
+        std::error_code ec;
+        std::filesystem::path p = std::filesystem::absolute(image, ec);
+        if (!ec) p = std::filesystem::weakly_canonical(p, ec);
+        return ec ? image : p.string();
+    }
+
+    static std::string key(const std::string& image, const std::string& codec, int quality)
+    {
+        std::string k = image;
+        k += '\0';
+        k += codec;
+        k += '\0';
+        k += std::to_string(quality);
+        return k;
+    }
+
+    static std::vector<uint8_t> encode_csv(const std::vector<ResultsRow>& rows)
+    {
+        std::string text;
+        char num[64];
+        for (const ResultsRow& r : rows) {
+            results_log_detail::put_csv_field(text, r.image);
+            text += ',';
+            results_log_detail::put_csv_field(text, r.codec);
+            std::snprintf(num, sizeof(num), ",%d,%.6f,%llu\n", r.quality, r.psnr,
+                          static_cast<unsigned long long>(r.size_bytes));
+            text += num;
+        }
+        return std::vector<uint8_t>(text.begin(), text.end());
+    }
+
+    static std::vector<uint8_t> encode_batch(const std::vector<ResultsRow>& rows)
+    {
+        using namespace results_log_detail;
+        std::vector<uint8_t> payload;
+        put_strings(payload, rows, &ResultsRow::image);
+        put_strings(payload, rows, &ResultsRow::codec);
+        for (const ResultsRow& r : rows) put(payload, int32_t(r.quality));
+        for (const ResultsRow& r : rows) put(payload, r.psnr);
+        for (const ResultsRow& r : rows) put(payload, r.size_bytes);
+
+        std::vector<uint8_t> out;
+        out.reserve(payload.size() + 12);
+        put(out, uint32_t(rows.size()));
+        put(out, uint32_t(payload.size()));
+        out.insert(out.end(), payload.begin(), payload.end());
+        put(out, crc32(out.data(), out.size()));
+        return out;
+    }
+
+    // Parse a log; valid_bytes is the length of its intact prefix, skipped
+    // counts complete CSV lines that did not parse
+    static bool scan(const std::string& path, ResultsFormat format,
+                     std::vector<ResultsRow>& rows, uint64_t& valid_bytes, size_t& skipped)
+    {
+        using namespace results_log_detail;
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::vector<uint8_t> data;
+        uint8_t chunk[1 << 16];
+        for (size_t n; (n = std::fread(chunk, 1, sizeof(chunk), f)) > 0;)
+            data.insert(data.end(), chunk, chunk + n);
+        std::fclose(f);
+
+        valid_bytes = 0;
+        skipped = 0;
+        if (data.empty()) return true;
+
+        if (format == ResultsFormat::CSV) {
+            const std::string text(data.begin(), data.end());
+            size_t pos = text.find('\n');
+            if (pos == std::string::npos) return true;  // torn header
+            if (text.compare(0, pos + 1, kCsvHeader) != 0) return false;
+            valid_bytes = pos + 1;
+
+            // Only lines terminated by '\n' count
+            for (size_t next; (next = text.find('\n', valid_bytes)) != std::string::npos; valid_bytes = next + 1) {
+                const std::vector<std::string> fields = split_csv_line(text.substr(valid_bytes, next - valid_bytes));
+                ResultsRow r;
+                bool ok = fields.size() == 5;
+                if (ok) {
+                    r.image = fields[0];
+                    r.codec = fields[1];
+                    try {
+                        r.quality = std::stoi(fields[2]);
+                        r.psnr = std::stod(fields[3]);
+                        r.size_bytes = std::stoull(fields[4]);
+                    } catch (const std::exception&) {
+                        ok = false;
+                    }
+                }
+                if (ok) rows.push_back(std::move(r));
+                else ++skipped;
+            }
+            return true;
+        }
+
+        if (data.size() < 4) return true;                                 // torn magic
+        if (std::memcmp(data.data(), kMagic, 4) != 0) return false;
+        valid_bytes = 4;
+
+        // Stop at the first incomplete or corrupt batch. The row count is
+        // checked against the payload before anything is allocated.
+        const uint8_t* p = data.data() + 4;
+        const uint8_t* end = data.data() + data.size();
+        for (;;) {
+            const uint8_t* header = p;
+            uint32_t n = 0, size = 0, crc = 0;
+            if (!get(p, end, n) || !get(p, end, size)) break;
+            if (size_t(end - p) < size_t(size) + 4 || uint64_t(n) * kMinRowBytes + 8 > size) break;
+            const uint8_t* crc_pos = p + size;
+            if (!get(crc_pos, end, crc) || crc32(header, size_t(8) + size) != crc) break;
+
+            const uint8_t* q = p;
+            const uint8_t* batch_end = p + size;
+            std::vector<ResultsRow> batch(n);
+            bool ok = get_strings(q, batch_end, batch, &ResultsRow::image) &&
+                      get_strings(q, batch_end, batch, &ResultsRow::codec);
+            for (ResultsRow& r : batch) { int32_t v = 0; ok = ok && get(q, batch_end, v); r.quality = v; }
+            for (ResultsRow& r : batch) ok = ok && get(q, batch_end, r.psnr);
+            for (ResultsRow& r : batch) ok = ok && get(q, batch_end, r.size_bytes);
+            if (!ok) break;
+
+            rows.insert(rows.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            p = batch_end + 4;
+            valid_bytes = uint64_t(p - data.data());
+        }
+        return true;
+    }
+
+    std::string path_;
+    ResultsFormat format_;
+    ResultsLogOptions opts_;
+    std::FILE* file_ = nullptr;
+    std::vector<ResultsRow> pending_;           // Rows not yet written
+    std::unordered_set<std::string> done_;      // Keys of all rows in the log
+    size_t resumed_ = 0;                        // Rows found when opening
+    size_t written_ = 0;                        // Rows written by this instance
+    size_t skipped_ = 0;                        // Unparsable CSV lines when opening
+    int unsynced_ = 0;                          // Write‑outs since the last fsync
+};
+
+#endif // RESULTS_LOG_H
@@ -0,0 +1,552 @@
+// watch_daemon.h – header‑only watch‑folder daemon: new images are pushed
+// through load → encode → verify‑decode → metric → write stages connected by
+// bounded queues
+
+#ifndef WATCH_DAEMON_H
+#define WATCH_DAEMON_H
+
+#include "corpus_sweep.h"        // isCorpusImage, HEIC / JPEG helpers
+#include "results_log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------
+// Blocking FIFO with a fixed capacity. push() waits while the queue is full
+// (backpressure to the producer), pop() waits while it is empty and returns
+// false once the queue is closed and drained.
+// ----------------------------------------------------------------------------
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // No more pushes; consumers finish what is queued
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+// ----------------------------------------------------------------------------
+// Daemon settings and statistics
+// ----------------------------------------------------------------------------
+struct WatchOptions {
+    std::string watch_dir;                       // Directory to watch (not recursive)
+    std::string output_dir;                      // Encoded files: <stem>_<ext>_q<N>.jpg / .heic
+    std::string log_path;                        // ResultsLog (.csv or .rlog)
+    std::vector<std::string> codecs = {"jpeg-dct", "heic-ycbcr"};   // see isCorpusCodec
+    std::vector<int> qualities = {50, 80};
+    size_t queue_capacity = 8;                   // Per stage queue
+    int encode_threads = 0;                      // 0 = all cores
+    bool process_existing = true;                // Handle images already in watch_dir on start
+    int poll_ms = 500;                           // Stop check / rescan interval
+    ResultsLogOptions log_options;
+};
+
+struct WatchStats {
+    static constexpr int kQueues = 5;            // watch→load→encode→decode→metric→write
+    double uptime_s = 0.0;
+    size_t images_queued = 0;                    // Paths handed to the load stage
+    size_t images_loaded = 0;
+    size_t encodes = 0;                          // Encoded (image, codec, quality) points
+    size_t rows_written = 0;                     // Points fully processed and logged
+    size_t skipped = 0;                          // Points already logged or in the pipeline
+    size_t failures = 0;                         // Load / encode / decode errors
+    size_t depth[kQueues] = {};                  // Current queue fill levels
+    size_t capacity = 0;
+    double images_per_s = 0.0;                   // Loaded images over uptime
+    double points_per_s = 0.0;                   // Logged rows over uptime
+};
+
+inline std::ostream& operator<<(std::ostream& os, const WatchStats& s)
+{
+    static const char* names[WatchStats::kQueues] = {"load", "encode", "decode", "metric", "write"};
+    os << std::fixed << std::setprecision(1) << s.uptime_s << " s: " << s.images_loaded << '/' << s.images_queued
+       << " images, " << s.rows_written << " rows, " << s.skipped << " skipped (" << std::setprecision(2) << s.images_per_s << " img/s, "
+       << s.points_per_s << " rows/s), " << s.failures << " failures, queues";
+    for (int i = 0; i < WatchStats::kQueues; ++i)
+        os << ' ' << names[i] << '=' << s.depth[i] << '/' << s.capacity;
+    return os;
+}
+
+// ----------------------------------------------------------------------------
+// Watch‑folder daemon
+//
+// Stages (one thread each unless noted), connected by BoundedQueue:
+//   watch   inotify (IN_CLOSE_WRITE / IN_MOVED_TO) on Linux, directory
+//           polling elsewhere; emits image paths
+//   load    JpgEncoder load + alpha composite (RGB for HEIC as in the sweeps)
+//   encode  the corpus codecs (isCorpusCodec) for every quality
+//           (encode_threads workers)
+//   decode  JpgDecoder / HeicDecoder from memory
+//   metric  computePSNR
+//   write   encoded file to output_dir, row to the ResultsLog
+// A full queue blocks its producer, so a slow stage throttles the ones
+// before it instead of piling up memory. stop() ends the watcher; every
+// stage drains its input before it closes the next queue, so everything
+// accepted is finished and logged.
+//
+// Encoding goes through the corpus paths instead of JpgEncoder::jpeg_compress
+// and HeicEncoder::encode_image: those write a file per quality and convert
+// the source again each time, while "jpeg-dct" (JpegDctSweep) transforms the
+// image once and "heic-ycbcr" converts it once and encodes with
+// HeicEncoder::encode_to_memory. Rows carry these codec names, so they are
+// never mixed with results of the file-based encoders.
+//
+// An (image, codec, quality) point that is already in the log, or already on
+// its way through the pipeline, is skipped: a restart finishes partially
+// logged images and an inotify overflow rescan only picks up what is missing.
+// A point that fails is released again so a later event retries it.
+// ----------------------------------------------------------------------------
+class WatchDaemon {
+public:
+    explicit WatchDaemon(WatchOptions opts)
+        : opts_(std::move(opts)),
+          log_(opts_.log_path, ResultsLog::formatForPath(opts_.log_path), opts_.log_options),
+          paths_(opts_.queue_capacity), images_(opts_.queue_capacity), encoded_(opts_.queue_capacity),
+          decoded_(opts_.queue_capacity), measured_(opts_.queue_capacity)
+    {
+        if (!std::filesystem::is_directory(opts_.watch_dir))
+            throw std::runtime_error("not a directory: " + opts_.watch_dir);
+        std::filesystem::create_directories(opts_.output_dir);
+        // Every written variant would raise an event and be encoded again
+        if (std::filesystem::equivalent(opts_.output_dir, opts_.watch_dir))
+            throw std::runtime_error("output directory must differ from the watched directory");
+    }
+
+    ~WatchDaemon()
+    {
+        stop();
+        wait();
+    }
+
+    WatchDaemon(const WatchDaemon&) = delete;
+    WatchDaemon& operator=(const WatchDaemon&) = delete;
+
+    // Set up the watch and start all stage threads
+    bool start()
+    {
+        if (!threads_.empty()) return false;
+
+#ifdef __linux__
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0 ||
+            inotify_add_watch(inotify_fd_, opts_.watch_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "(WATCH) Cannot watch " << opts_.watch_dir << '\n';
+            if (inotify_fd_ >= 0) close(inotify_fd_);
+            inotify_fd_ = -1;
+            return false;
+        }
+#endif
+
+        // Images already present (the log is read here, before the writer
+        // thread owns it)
+        std::vector<std::string> existing;
+        if (opts_.process_existing) {
+            for (const std::string& path : scan())
+                if (!fully_logged(path)) existing.push_back(path);
+        }
+
+        start_time_ = std::chrono::steady_clock::now();
+        threads_.emplace_back([this, existing] { watch_stage(existing); });
+        threads_.emplace_back([this] { load_stage(); });
+        const int n_enc = opts_.encode_threads > 0 ? opts_.encode_threads
+                                                   : std::max(1, int(std::thread::hardware_concurrency()));
+        encoders_left_ = n_enc;
+        for (int i = 0; i < n_enc; ++i) threads_.emplace_back([this] { encode_stage(); });
+        threads_.emplace_back([this] { decode_stage(); });
+        threads_.emplace_back([this] { metric_stage(); });
+        threads_.emplace_back([this] { write_stage(); });
+        return true;
+    }
+
+    // Stop watching; queued work is still completed (see wait())
+    void stop() { stop_ = true; }
+
+    // Join all stages; returns after the last row is logged and synced
+    void wait()
+    {
+        if (threads_.empty()) return;
+        for (std::thread& t : threads_)
+            if (t.joinable()) t.join();
+        threads_.clear();
+        end_time_ = std::chrono::steady_clock::now();
+#ifdef __linux__
+        if (inotify_fd_ >= 0) close(inotify_fd_);
+        inotify_fd_ = -1;
+#endif
+    }
+
+    WatchStats stats() const
+    {
+        WatchStats s;
+        const auto end = threads_.empty() ? end_time_ : std::chrono::steady_clock::now();
+        s.uptime_s = std::chrono::duration<double>(end - start_time_).count();
+        s.images_queued = images_queued_;
+        s.images_loaded = images_loaded_;
+        s.encodes = encodes_;
+        s.rows_written = rows_written_;
+        s.failures = failures_;
+        s.skipped = skipped_;
+        s.depth[0] = paths_.size();
+        s.depth[1] = images_.size();
+        s.depth[2] = encoded_.size();
+        s.depth[3] = decoded_.size();
+        s.depth[4] = measured_.size();
+        s.capacity = opts_.queue_capacity;
+        if (s.uptime_s > 0.0) {
+            s.images_per_s = double(s.images_loaded) / s.uptime_s;
+            s.points_per_s = double(s.rows_written) / s.uptime_s;
+        }
+        return s;
+    }
+
+private:
+    // Work items ---------------------------------------------------------------
+    struct Image {
+        std::string path;
+        int width = 0, height = 0;
+        std::vector<unsigned char> rgb_masked;   // Alpha composited on white (JPEG reference)
+        std::vector<unsigned char> rgb;          // Plain RGB (HEIC reference)
+    };
+
+    struct Point {
+        std::shared_ptr<const Image> image;
+        std::string codec;
+        int quality = 0;
+        std::vector<uint8_t> bytes;              // Encoded file
+        std::vector<uint8_t> decoded;            // Verify‑decode RGB, dropped after the metric
+        double psnr = 0.0;
+    };
+
+    // Stages ---------------------------------------------------------------------
+    void watch_stage(const std::vector<std::string>& existing)
+    {
+        for (const std::string& path : existing) enqueue(path);
+
+#ifdef __linux__
+        alignas(inotify_event) char buf[16 * 1024];
+        while (!stop_) {
+            pollfd pfd{inotify_fd_, POLLIN, 0};
+            if (poll(&pfd, 1, opts_.poll_ms) <= 0) continue;
+
+            const ssize_t len = read(inotify_fd_, buf, sizeof(buf));
+            for (ssize_t off = 0; off < len;) {
+                const auto* ev = reinterpret_cast<const inotify_event*>(buf + off);
+                off += ssize_t(sizeof(inotify_event) + ev->len);
+
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    // Kernel dropped events: take the whole directory again
+                    // (points already logged or in flight are skipped)
+                    std::cerr << "(WATCH) Event queue overflow, rescanning\n";
+                    for (const std::string& path : scan()) enqueue(path);
+                } else if (ev->len && !(ev->mask & IN_ISDIR)) {
+                    const std::filesystem::path path = std::filesystem::path(opts_.watch_dir) / ev->name;
+                    if (isCorpusImage(path)) enqueue(path.string());
+                }
+            }
+        }
+#else
+        // Portable fallback: poll the directory and compare modification times
+        std::unordered_map<std::string, std::filesystem::file_time_type> seen;
+        for (const std::string& path : scan()) seen[path] = std::filesystem::last_write_time(path);
+        while (!stop_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(opts_.poll_ms));
+            for (const std::string& path : scan()) {
+                std::error_code ec;
+                const auto t = std::filesystem::last_write_time(path, ec);
+                if (ec) continue;
+                auto it = seen.find(path);
+                if (it == seen.end() || it->second != t) {
+                    seen[path] = t;
+                    enqueue(path);
+                }
+            }
+        }
+#endif
+        paths_.close();
+    }
+
+    void load_stage()
+    {
+        std::string path;
+        while (paths_.pop(path)) {
+            if (fully_logged(path)) {                     // nothing left to do, not even a decode
+                skipped_ += opts_.codecs.size() * opts_.qualities.size();
+                continue;
+            }
+            auto image = std::make_shared<Image>();
+            image->path = path;
+            try {
+                JpgEncoder src(path.c_str(), "unused.jpg");   // the only decode of the file (RGBA)
+                src.applyAlphaMask();
+                image->width = src.getWidth();
+                image->height = src.getHeight();
+                const size_t pixels = size_t(image->width) * image->height;
+                image->rgb_masked.assign(src.getData(), src.getData() + pixels * 3);
+
+                // Alpha dropped without compositing, same pixels as stbi_load(..., 3)
+                const unsigned char* rgba = src.getRGBAData();
+                image->rgb.resize(pixels * 3);
+                for (size_t i = 0; i < pixels; ++i)
+                    std::memcpy(&image->rgb[i * 3], rgba + i * 4, 3);
+            } catch (...) {
+                std::cerr << "(WATCH) Could not load " << path << '\n';
+                ++failures_;
+                continue;
+            }
+            ++images_loaded_;
+            images_.push(std::move(image));
+        }
+        images_.close();
+    }
+
+    void encode_stage()
+    {
+        std::shared_ptr<Image> image;
+        while (images_.pop(image)) {
+            for (const std::string& codec : opts_.codecs) {
+                std::vector<int> todo;
+                for (int q : opts_.qualities)
+                    if (claim(image->path, codec, q)) todo.push_back(q);
+                    else ++skipped_;
+                if (todo.empty()) continue;
+
+                if (codec == "jpeg-dct") {
+                    const JpegDctSweep sweep(image->rgb_masked.data(), image->width, image->height, 1);
+                    for (int q : todo) {
+                        Point p{image, codec, q, {}, {}, 0.0};
+                        if (sweep.encode(q, p.bytes)) emit(std::move(p));
+                        else fail("JPEG encode", p);
+                    }
+                } else if (codec == "heic-ycbcr") {
+                    const HeicYCbCrOptions ycbcr;
+                    heif_image* source =
+                        HeicEncoder::make_ycbcr_image(image->rgb.data(), image->width, image->height, ycbcr);
+                    for (int q : todo) {
+                        Point p{image, codec, q, {}, {}, 0.0};
+                        if (source && HeicEncoder::encode_to_memory(source, q, p.bytes,
+                                                                    HeicEncoder::chroma_param(ycbcr.chroma),
+                                                                    HeicEncoder::ycbcr_params(ycbcr)))
+                            emit(std::move(p));
+                        else fail("HEIC encode", p);
+                    }
+                    if (source) heif_image_release(source);
+                } else {
+                    for (int q : todo) fail("unknown codec " + codec, Point{image, codec, q, {}, {}, 0.0});
+                }
+            }
+        }
+        if (--encoders_left_ == 0) encoded_.close();     // last encoder out closes
+    }
+
+    void decode_stage()
+    {
+        Point p;
+        while (encoded_.pop(p)) {
+            bool ok = false;
+            int w = 0, h = 0;
+            if (p.codec == "jpeg-dct") {
+                JpgDecoder dec("", "unused.png");
+                ok = dec.jpeg_decompress_buffer(p.bytes.data(), static_cast<unsigned long>(p.bytes.size()));
+                if (ok) {
+                    w = dec.getWidth();
+                    h = dec.getHeight();
+                    p.decoded.assign(dec.getRGBData(), dec.getRGBData() + size_t(w) * h * 3);
+                }
+            } else {
+                ok = HeicDecoder::decode_memory_to_rgb(p.bytes.data(), p.bytes.size(), p.decoded, w, h);
+            }
+            if (!ok || w != p.image->width || h != p.image->height) {
+                fail("verify decode", p);
+                continue;
+            }
+            decoded_.push(std::move(p));
+        }
+        decoded_.close();
+    }
+
+    void metric_stage()
+    {
+        Point p;
+        while (decoded_.pop(p)) {
+            const std::vector<unsigned char>& ref = p.codec == "jpeg-dct" ? p.image->rgb_masked : p.image->rgb;
+            p.psnr = computePSNR(ref.data(), p.decoded.data(), p.image->width, p.image->height);
+            p.decoded = {};
+            measured_.push(std::move(p));
+        }
+        measured_.close();
+    }
+
+    void write_stage()
+    {
+        Point p;
+        while (measured_.pop(p)) {
+            const std::filesystem::path out = std::filesystem::path(opts_.output_dir) / output_name(p);
+            std::ofstream file(out, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(p.bytes.data()), std::streamsize(p.bytes.size()));
+            file.close();
+            if (!file) {
+                fail("write " + out.string(), p);
+                continue;                                 // not logged, so a rerun retries it
+            }
+
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            log_.append({p.image->path, p.codec, p.quality, p.psnr, p.bytes.size()});
+            ++rows_written_;
+        }
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        log_.flush(true);
+    }
+
+    // Helpers --------------------------------------------------------------------
+    std::vector<std::string> scan() const
+    {
+        std::vector<std::string> images;
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(opts_.watch_dir, ec), end; !ec && it != end; it.increment(ec))
+            if (it->is_regular_file() && isCorpusImage(it->path()))
+                images.push_back(it->path().string());
+        std::sort(images.begin(), images.end());
+        return images;
+    }
+
+    // <stem>_<ext>_q<N>: a.png and a.jpg in the watched directory get
+    // different outputs
+    static std::string output_name(const Point& p)
+    {
+        const std::filesystem::path src(p.image->path);
+        std::string ext = src.extension().string();
+        if (!ext.empty()) ext.erase(0, 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return src.stem().string() + "_" + ext + "_q" + std::to_string(p.quality) +
+               (p.codec == "jpeg-dct" ? ".jpg" : ".heic");
+    }
+
+    static std::string point_key(const std::string& path, const std::string& codec, int quality)
+    {
+        return path + '\0' + codec + '\0' + std::to_string(quality);
+    }
+
+    // True if every point of the image is logged or in the pipeline
+    bool fully_logged(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        for (const std::string& codec : opts_.codecs)
+            for (int q : opts_.qualities)
+                if (!log_.contains(path, codec, q) && !claimed_.count(point_key(path, codec, q))) return false;
+        return true;
+    }
+
+    // Take a point for this pipeline run; false if it is logged or in flight
+    bool claim(const std::string& path, const std::string& codec, int quality)
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        return !log_.contains(path, codec, quality) && claimed_.insert(point_key(path, codec, quality)).second;
+    }
+
+    void enqueue(const std::string& path)
+    {
+        ++images_queued_;
+        paths_.push(path);                                // blocks while the loader is behind
+    }
+
+    void emit(Point p)
+    {
+        ++encodes_;
+        encoded_.push(std::move(p));
+    }
+
+    // Count a failed point and release its claim, so a later event retries it
+    void fail(const std::string& what, const Point& p)
+    {
+        std::cerr << "(WATCH) " << what << " failed at quality=" << p.quality << " for " << p.image->path << '\n';
+        ++failures_;
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        claimed_.erase(point_key(p.image->path, p.codec, p.quality));
+    }
+
+    WatchOptions opts_;
+    ResultsLog log_;                                      // Guarded by log_mutex_ once started
+    std::mutex log_mutex_;
+    std::unordered_set<std::string> claimed_;             // Points taken by this run (log_mutex_)
+
+    BoundedQueue<std::string> paths_;
+    BoundedQueue<std::shared_ptr<Image>> images_;
+    BoundedQueue<Point> encoded_;
+    BoundedQueue<Point> decoded_;
+    BoundedQueue<Point> measured_;
+
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stop_{false};
+    std::atomic<int> encoders_left_{0};
+    std::chrono::steady_clock::time_point start_time_, end_time_;   // Run time for the stats
+#ifdef __linux__
+    int inotify_fd_ = -1;
+#endif
+
+    std::atomic<size_t> images_queued_{0}, images_loaded_{0}, encodes_{0}, rows_written_{0}, failures_{0},
+        skipped_{0};
+};
+
+#endif // WATCH_DAEMON_H
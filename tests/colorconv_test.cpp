@@ -0,0 +1,180 @@
+// colorconv_test.cpp – fixed-point RGB → YCbCr conversion against a float reference
+//
+// For every matrix, range, chroma format and siting: grey maps to Y = grey
+// (limited range: 16 + 219/255 · grey) and Cb = Cr = 128 exactly, luma is
+// within 1 of the float reference, chroma within 1 (4:4:4) or 2 (filtered
+// 4:2:0 / 4:2:2, the filter rounds before the matrix), and the threaded
+// conversion is bit-identical to the single-threaded one. Odd sizes cover
+// the border replication and the scalar tail of the SSE2 loop.
+//
+// Usage:
+//   colorconv_test
+
+#include "colorconv.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "(COLORCONV) FAILED: " << what << '\n';
+        ++g_failures;
+    }
+}
+
+struct Planes {
+    int w, h, cw, ch;
+    std::vector<uint8_t> y, cb, cr;
+
+    Planes(int width, int height, ChromaFormat f)
+        : w(width), h(height), cw(chroma_width(f, width)), ch(chroma_height(f, height)),
+          y(size_t(w) * h), cb(size_t(cw) * ch), cr(size_t(cw) * ch) {}
+
+    YCbCrPlanes view() { return {y.data(), w, cb.data(), cw, cr.data(), cw}; }
+};
+
+static Planes convert(const std::vector<uint8_t>& rgb, int w, int h, ChromaFormat f, YCbCrMatrix m,
+                      bool full, ChromaSiting s, int threads)
+{
+    Planes p(w, h, f);
+    rgbToYCbCr(rgb.data(), w, h, w * 3, p.view(), f, m, full, threads, s);
+    return p;
+}
+
+static std::vector<uint8_t> make_noise(int w, int h)
+{
+    std::vector<uint8_t> rgb(size_t(w) * h * 3);
+    uint32_t state = 0x12345u;
+    for (uint8_t& c : rgb) {
+        state = state * 1664525u + 1013904223u;
+        c = static_cast<uint8_t>(state >> 24);
+    }
+    return rgb;
+}
+
+// ---- Float reference ---------------------------------------------------------
+struct Ref {
+    double kr, kb, ys, cs, yo;
+
+    Ref(YCbCrMatrix m, bool full)
+        : kr(m == YCbCrMatrix::BT709 ? 0.2126 : 0.299), kb(m == YCbCrMatrix::BT709 ? 0.0722 : 0.114),
+          ys(full ? 1.0 : 219.0 / 255.0), cs(full ? 1.0 : 224.0 / 255.0), yo(full ? 0.0 : 16.0) {}
+
+    double y(double r, double g, double b) const { return yo + ys * (kr * r + (1 - kr - kb) * g + kb * b); }
+    double cb(double r, double g, double b) const
+    {
+        return 128.0 + cs * 0.5 * (b - (kr * r + (1 - kr - kb) * g + kb * b)) / (1.0 - kb);
+    }
+    double cr(double r, double g, double b) const
+    {
+        return 128.0 + cs * 0.5 * (r - (kr * r + (1 - kr - kb) * g + kb * b)) / (1.0 - kr);
+    }
+};
+
+// Source value of channel c at the chroma position (cx, cy), filtered as the
+// siting prescribes, borders replicated
+static double filtered(const std::vector<uint8_t>& rgb, int w, int h, ChromaFormat f, ChromaSiting s,
+                       int cx, int cy, int c)
+{
+    auto px = [&](int x, int y) {
+        x = std::clamp(x, 0, w - 1);
+        y = std::clamp(y, 0, h - 1);
+        return double(rgb[(size_t(y) * w + x) * 3 + c]);
+    };
+    const bool sub_v = f == ChromaFormat::C420;
+    const int y0 = sub_v ? 2 * cy : cy;
+    const int y1 = sub_v ? 2 * cy + 1 : cy;
+    auto row = [&](int y) {
+        if (f == ChromaFormat::C444) return px(cx, y);
+        const int x0 = 2 * cx;
+        return s == ChromaSiting::Left ? (px(x0 - 1, y) + 2 * px(x0, y) + px(x0 + 1, y)) / 4.0
+                                       : (px(x0, y) + px(x0 + 1, y)) / 2.0;
+    };
+    return (row(y0) + row(y1)) / 2.0;
+}
+
+static std::string name(ChromaFormat f, YCbCrMatrix m, bool full, ChromaSiting s)
+{
+    return std::string(f == ChromaFormat::C420 ? "4:2:0" : f == ChromaFormat::C422 ? "4:2:2" : "4:4:4") +
+           (m == YCbCrMatrix::BT709 ? " BT.709" : " BT.601") + (full ? " full" : " limited") +
+           (s == ChromaSiting::Left ? " left" : " center");
+}
+
+// ---- Checks ------------------------------------------------------------------
+static void check_grey(ChromaFormat f, YCbCrMatrix m, bool full, ChromaSiting s)
+{
+    const int w = 256, h = 2;
+    std::vector<uint8_t> rgb(size_t(w) * h * 3);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            for (int c = 0; c < 3; ++c) rgb[(size_t(y) * w + x) * 3 + c] = static_cast<uint8_t>(x);
+
+    const Planes p = convert(rgb, w, h, f, m, full, s, 1);
+    int y_bad = 0, c_bad = 0;
+    for (int x = 0; x < w; ++x) {
+        const int expected = full ? x : int(std::lround(16.0 + 219.0 * x / 255.0));
+        y_bad += p.y[x] != expected;
+    }
+    for (size_t i = 0; i < p.cb.size(); ++i) c_bad += p.cb[i] != 128 || p.cr[i] != 128;
+    check(y_bad == 0, name(f, m, full, s) + ": grey luma off in " + std::to_string(y_bad) + " samples");
+    check(c_bad == 0, name(f, m, full, s) + ": grey chroma != 128 in " + std::to_string(c_bad) + " samples");
+}
+
+static void check_reference(ChromaFormat f, YCbCrMatrix m, bool full, ChromaSiting s)
+{
+    const int w = 77, h = 45;      // odd: border replication and SSE2 tail
+    const std::vector<uint8_t> rgb = make_noise(w, h);
+    const Planes p = convert(rgb, w, h, f, m, full, s, 1);
+    const Ref ref(m, full);
+
+    double y_err = 0.0, c_err = 0.0;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            const uint8_t* px = &rgb[(size_t(y) * w + x) * 3];
+            y_err = std::max(y_err, std::abs(p.y[size_t(y) * w + x] - ref.y(px[0], px[1], px[2])));
+        }
+    for (int cy = 0; cy < p.ch; ++cy)
+        for (int cx = 0; cx < p.cw; ++cx) {
+            const double r = filtered(rgb, w, h, f, s, cx, cy, 0);
+            const double g = filtered(rgb, w, h, f, s, cx, cy, 1);
+            const double b = filtered(rgb, w, h, f, s, cx, cy, 2);
+            const size_t i = size_t(cy) * p.cw + cx;
+            c_err = std::max({c_err, std::abs(p.cb[i] - ref.cb(r, g, b)), std::abs(p.cr[i] - ref.cr(r, g, b))});
+        }
+    const double c_limit = f == ChromaFormat::C444 ? 1.0 : 2.0;
+    check(y_err <= 1.0, name(f, m, full, s) + ": max luma error " + std::to_string(y_err));
+    check(c_err <= c_limit, name(f, m, full, s) + ": max chroma error " + std::to_string(c_err));
+}
+
+static void check_threads(ChromaFormat f, ChromaSiting s)
+{
+    const int w = 203, h = 517;    // enough row pairs for four bands, odd last band
+    const std::vector<uint8_t> rgb = make_noise(w, h);
+    const Planes single = convert(rgb, w, h, f, YCbCrMatrix::BT601, true, s, 1);
+    const Planes threaded = convert(rgb, w, h, f, YCbCrMatrix::BT601, true, s, 4);
+    check(single.y == threaded.y && single.cb == threaded.cb && single.cr == threaded.cr,
+          name(f, YCbCrMatrix::BT601, true, s) + ": threaded output differs from single-threaded");
+}
+
+int main()
+{
+    for (ChromaFormat f : {ChromaFormat::C420, ChromaFormat::C422, ChromaFormat::C444})
+        for (ChromaSiting s : {ChromaSiting::Center, ChromaSiting::Left}) {
+            for (YCbCrMatrix m : {YCbCrMatrix::BT601, YCbCrMatrix::BT709})
+                for (bool full : {true, false}) {
+                    check_grey(f, m, full, s);
+                    check_reference(f, m, full, s);
+                }
+            check_threads(f, s);
+        }
+
+    if (g_failures == 0) std::cout << "(COLORCONV) All checks passed\n";
+    return g_failures == 0 ? 0 : 1;
+}
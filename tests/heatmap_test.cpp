@@ -0,0 +1,166 @@
+// heatmap_test.cpp – tiled error map against the whole-image PSNR and binary export
+//
+// The per-tile MSEs, weighted by tile area, must add up to the MSE behind
+// computePSNR for the whole image (border tiles are partial), the threaded map
+// must equal the single-threaded one, and the binary file must round-trip
+// bit-exactly, be little endian and be refused when its header does not
+// describe a tiling of the image or the file is truncated.
+//
+// Usage:
+//   heatmap_test [--workdir <dir>]
+
+#include "heatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "(HEATMAP) FAILED: " << what << '\n';
+        ++g_failures;
+    }
+}
+
+static std::vector<unsigned char> make_noise(int w, int h, uint32_t state, int amplitude, const unsigned char* base)
+{
+    std::vector<unsigned char> px(size_t(w) * h * 3);
+    for (size_t i = 0; i < px.size(); ++i) {
+        state = state * 1664525u + 1013904223u;
+        const int noise = int(state >> 24) % (2 * amplitude + 1) - amplitude;
+        const int v = (base ? base[i] : 128) + noise;
+        px[i] = static_cast<unsigned char>(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+    return px;
+}
+
+// Whole-image MSE recombined from the tiles
+static double combined_mse(const ErrorHeatmap& map)
+{
+    double sse = 0.0;
+    for (int r = 0; r < map.rows; ++r)
+        for (int c = 0; c < map.cols; ++c) {
+            const int tw = std::min(map.tile, map.width - c * map.tile);
+            const int th = std::min(map.tile, map.height - r * map.tile);
+            sse += double(map.mse[size_t(r) * map.cols + c]) * tw * th * 3;
+        }
+    return sse / (double(map.width) * map.height * 3);
+}
+
+static void check_against_psnr(int w, int h, int tile)
+{
+    const std::string name = std::to_string(w) + "x" + std::to_string(h) + " tile " + std::to_string(tile);
+    const std::vector<unsigned char> a = make_noise(w, h, 7u, 100, nullptr);
+    const std::vector<unsigned char> b = make_noise(w, h, 99u, 9, a.data());
+
+    const ErrorHeatmap map = computeErrorHeatmap(a.data(), b.data(), w, h, tile, 1);
+    check(map.cols == (w + tile - 1) / tile && map.rows == (h + tile - 1) / tile, name + ": tile grid");
+
+    const double whole = computePSNR(a.data(), b.data(), w, h);
+    const double tiles = psnrFromMSE(combined_mse(map));
+    check(std::abs(whole - tiles) < 1e-4,
+          name + ": tiles give " + std::to_string(tiles) + " dB, whole image " + std::to_string(whole) + " dB");
+
+    const ErrorHeatmap threaded = computeErrorHeatmap(a.data(), b.data(), w, h, tile, 4);
+    check(threaded.mse == map.mse, name + ": threaded map differs");
+
+    const ErrorHeatmap exact = computeErrorHeatmap(a.data(), a.data(), w, h, tile, 1);
+    check(std::isinf(exact.psnr(0, 0)), name + ": identical tile not reported as inf");
+}
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+}
+
+static void check_binary(const fs::path& workdir)
+{
+    const int w = 75, h = 41, tile = 16;
+    const std::vector<unsigned char> a = make_noise(w, h, 3u, 100, nullptr);
+    const std::vector<unsigned char> b = make_noise(w, h, 5u, 20, a.data());
+    const ErrorHeatmap map = computeErrorHeatmap(a.data(), b.data(), w, h, tile);
+
+    const std::string path = (workdir / "map.ehm").string();
+    check(writeHeatmapBinary(map, path), "binary: write");
+
+    ErrorHeatmap back;
+    check(readHeatmapBinary(path, back), "binary: read");
+    check(back.width == w && back.height == h && back.tile == tile && back.cols == map.cols &&
+              back.rows == map.rows,
+          "binary: header round trip");
+    check(back.mse.size() == map.mse.size() &&
+              std::memcmp(back.mse.data(), map.mse.data(), map.mse.size() * sizeof(float)) == 0,
+          "binary: MSE values round trip");
+
+    // Little endian on every host: width 75 = 4B 00 00 00 after the magic
+    const std::vector<uint8_t> bytes = read_file(path);
+    check(bytes.size() == 24 + map.mse.size() * 4, "binary: file size");
+    check(bytes.size() >= 8 && bytes[4] == 75 && bytes[5] == 0 && bytes[6] == 0 && bytes[7] == 0,
+          "binary: width not little endian");
+
+    // Corrupt headers and truncation are refused
+    auto refused = [&](std::vector<uint8_t> corrupt, const std::string& what) {
+        const std::string bad = (workdir / "bad.ehm").string();
+        write_file(bad, corrupt);
+        ErrorHeatmap m;
+        check(!readHeatmapBinary(bad, m), "binary: " + what + " accepted");
+    };
+    std::vector<uint8_t> c = bytes;
+    c[4 + 3 * 4] = 6;                                   // cols 5 -> 6
+    refused(c, "wrong column count");
+    c = bytes;
+    c[4 + 4 * 4 + 3] = 0x40;                            // rows ~ 1e9, file far too small
+    refused(c, "huge row count");
+    c = bytes;
+    c[4 + 2 * 4] = 0;                                   // tile 0
+    refused(c, "tile 0");
+    c = bytes;
+    c.resize(c.size() - 3);
+    refused(c, "truncated file");
+    c = bytes;
+    c[0] = 'X';
+    refused(c, "wrong magic");
+}
+
+int main(int argc, char** argv)
+{
+    fs::path workdir = fs::temp_directory_path() / "heic_demo_heatmap";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--workdir" && i + 1 < argc) workdir = argv[++i];
+        else {
+            std::cerr << "Usage: heatmap_test [--workdir <dir>]\n";
+            return 2;
+        }
+    }
+    std::error_code ec;
+    fs::create_directories(workdir, ec);
+
+    check_against_psnr(64, 64, 16);     // exact tiling
+    check_against_psnr(101, 67, 16);    // partial border tiles
+    check_against_psnr(33, 9, 8);
+    check_against_psnr(40, 30, 1);
+    check_binary(workdir);
+
+    if (g_failures == 0) std::cout << "(HEATMAP) All checks passed\n";
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+// quality_predictor_test.cpp – complexity features and the calibrated quality model
+//
+// block_variance must equal the mean variance of the complete 8×8 luma blocks
+// computed directly; fit() on samples of a synthetic linear model must give
+// that model back through predictPSNR / predictQuality; save() / load() must
+// round-trip it, and a malformed model file leaves no model loaded. A sweep
+// CSV calibrates only with the measured "quality,psnr,size_bytes" header, not
+// with the estimate CSV of JpegEstimatePSNRtoCSV.
+//
+// Usage:
+//   quality_predictor_test [--workdir <dir>]
+
+#include "quality_predictor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "(PREDICTOR) FAILED: " << what << '\n';
+        ++g_failures;
+    }
+}
+
+static std::vector<unsigned char> make_image(int w, int h, uint32_t state)
+{
+    std::vector<unsigned char> rgb(size_t(w) * h * 3);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            for (int c = 0; c < 3; ++c) {
+                state = state * 1664525u + 1013904223u;
+                const int smooth = (x * 3 + y * 2 + c * 50) & 0xFF;
+                const int noise = int(state >> 27) - 16;             // ±16, texture for the blocks
+                rgb[(size_t(y) * w + x) * 3 + c] = static_cast<unsigned char>(std::clamp(smooth + noise, 0, 255));
+            }
+    return rgb;
+}
+
+// ---- Features ------------------------------------------------------------------
+static void check_block_variance(int w, int h)
+{
+    const std::vector<unsigned char> rgb = make_image(w, h, uint32_t(w * 31 + h));
+
+    // Same integer luma as computeComplexityFeatures, variance per complete block
+    auto luma = [&](int x, int y) {
+        const unsigned char* p = &rgb[(size_t(y) * w + x) * 3];
+        return (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+    };
+    double sum_var = 0.0;
+    int blocks = 0;
+    for (int by = 0; by + 8 <= h; by += 8)
+        for (int bx = 0; bx + 8 <= w; bx += 8) {
+            double mean = 0.0;
+            for (int y = by; y < by + 8; ++y)
+                for (int x = bx; x < bx + 8; ++x) mean += luma(x, y);
+            mean /= 64.0;
+            double var = 0.0;
+            for (int y = by; y < by + 8; ++y)
+                for (int x = bx; x < bx + 8; ++x) var += (luma(x, y) - mean) * (luma(x, y) - mean);
+            sum_var += var / 64.0;
+            ++blocks;
+        }
+    const double expected = blocks ? sum_var / blocks : 0.0;
+
+    const ComplexityFeatures f = computeComplexityFeatures(rgb.data(), w, h);
+    const std::string name = std::to_string(w) + "x" + std::to_string(h);
+    check(std::abs(f.block_variance - expected) < 1e-9 * std::max(1.0, expected),
+          name + ": block_variance " + std::to_string(f.block_variance) + ", direct " + std::to_string(expected));
+    check(f.gradient_energy > 0.0 && f.chroma_activity > 0.0, name + ": gradient / chroma features zero");
+}
+
+// ---- Model ---------------------------------------------------------------------
+// psnr = w0(q) + w1(q)·ln(1+g) + w2(q)·ln(1+v) + w3(q)·ln(1+c), linear in q
+static double true_psnr(const ComplexityFeatures& f, int q)
+{
+    return 20.0 + 0.25 * q + (-1.0 + 0.002 * q) * std::log1p(f.gradient_energy) +
+           (-0.8 + 0.001 * q) * std::log1p(f.block_variance) + (-0.3 - 0.001 * q) * std::log1p(f.chroma_activity);
+}
+
+static ComplexityFeatures random_features(uint32_t& state)
+{
+    auto uniform = [&](double lo, double hi) {
+        state = state * 1664525u + 1013904223u;
+        return lo + (hi - lo) * double(state >> 8) / double(1u << 24);
+    };
+    ComplexityFeatures f;
+    f.gradient_energy = std::exp(uniform(0.0, 7.0));
+    f.block_variance = std::exp(uniform(0.0, 7.0));
+    f.chroma_activity = std::exp(uniform(0.0, 5.0));
+    return f;
+}
+
+static const int kGrid[] = {10, 30, 50, 70, 90};
+static const char* kCodec = "jpeg-dct";
+
+static QualityPredictor fitted_model()
+{
+    QualityPredictor model;
+    uint32_t state = 12345u;
+    for (int i = 0; i < 40; ++i) {
+        const ComplexityFeatures f = random_features(state);
+        for (int q : kGrid) model.addSample(kCodec, f, q, true_psnr(f, q));
+    }
+    model.addSample(kCodec, random_features(state), 50, INFINITY);   // lossless point, ignored
+    model.fit();
+    return model;
+}
+
+static void check_fit()
+{
+    const QualityPredictor model = fitted_model();
+    check(model.hasModel(kCodec) && model.codecs().size() == 1, "fit: model missing");
+
+    uint32_t state = 999u;
+    double worst = 0.0;
+    int worst_q = 60;
+    for (int i = 0; i < 20; ++i) {
+        const ComplexityFeatures f = random_features(state);
+        for (int q : kGrid) worst = std::max(worst, std::abs(model.predictPSNR(kCodec, f, q) - true_psnr(f, q)));
+
+        // The true curve is linear in q, so its value at 60 lies on the
+        // 50 → 70 segment and the prediction has to land on 60
+        const int q = model.predictQuality(kCodec, f, true_psnr(f, 60));
+        if (std::abs(q - 60) > std::abs(worst_q - 60)) worst_q = q;
+    }
+    check(worst < 0.05, "fit: PSNR off the synthetic model by " + std::to_string(worst) + " dB");
+    check(std::abs(worst_q - 60) <= 1, "fit: predicted quality " + std::to_string(worst_q) + " for the q60 target");
+    check(model.predictQuality("heic-ycbcr", ComplexityFeatures{}, 30.0) == -1, "fit: prediction without a model");
+}
+
+static void check_save_load(const fs::path& workdir)
+{
+    const QualityPredictor model = fitted_model();
+    const std::string path = (workdir / "model.csv").string();
+    check(model.save(path), "save");
+
+    QualityPredictor back;
+    check(back.load(path), "load");
+    check(back.codecs() == model.codecs(), "load: codecs differ");
+    uint32_t state = 4242u;
+    for (int i = 0; i < 5; ++i) {
+        const ComplexityFeatures f = random_features(state);
+        for (int q : kGrid)
+            check(std::abs(back.predictPSNR(kCodec, f, q) - model.predictPSNR(kCodec, f, q)) < 1e-6,
+                  "load: prediction differs at q" + std::to_string(q));
+    }
+
+    // A short row (or a wrong header) rejects the file and clears the model
+    const std::string bad = (workdir / "bad_model.csv").string();
+    fs::copy_file(path, bad, fs::copy_options::overwrite_existing);
+    std::ofstream(bad, std::ios::app) << kCodec << ",95,1.0\n";
+    check(!back.load(bad), "load: short row accepted");
+    check(!back.hasModel(kCodec), "load: model kept after a short row");
+
+    check(back.load(path), "load: reload");
+    std::ofstream(bad, std::ios::trunc) << "quality,psnr,size_bytes\n50,40.0,1000\n";
+    check(!back.load(bad), "load: sweep CSV accepted as a model");
+    check(back.codecs().empty(), "load: model kept after a wrong header");
+}
+
+static void check_sweep_csv(const fs::path& workdir)
+{
+    const int w = 40, h = 24;
+    const std::vector<unsigned char> rgb = make_image(w, h, 7u);
+    const std::string image = (workdir / "sweep.png").string();
+    check(stbi_write_png(image.c_str(), w, h, 3, rgb.data(), w * 3) != 0, "sweep: write image");
+
+    const std::string measured = (workdir / "measured.csv").string();
+    std::ofstream(measured, std::ios::trunc) << "quality,psnr,size_bytes\n50,35.5,1200\n80,39.25,2100\n";
+    const std::string estimate = (workdir / "estimate.csv").string();
+    std::ofstream(estimate, std::ios::trunc)
+        << "quality,est_psnr,est_mse_y,est_mse_cb,est_mse_cr\n50,35.5,10.0,3.0,3.0\n";
+
+    QualityPredictor model;
+    check(model.addSweepCSV(image, measured, kCodec) == 2, "sweep: measured CSV not added");
+    check(model.addSweepCSV(image, estimate, kCodec) == 0, "sweep: estimate CSV accepted as measurements");
+    check(model.addSweepCSV(image, measured, "jpeg") == 0, "sweep: unknown codec accepted");
+}
+
+// ---- encodeAtTarget --------------------------------------------------------------
+static void check_failure_sentinel(const fs::path& workdir)
+{
+    const QualityPredictor model = fitted_model();
+    const PredictedEncodeResult r = encodeAtTarget((workdir / "missing.png").string(),
+                                                   (workdir / "missing.jpg").string(), model, kCodec, 40.0);
+    check(r.encodes == 0 && std::isnan(r.psnr), "encodeAtTarget: failure not reported as NAN");
+}
+
+int main(int argc, char** argv)
+{
+    fs::path workdir = fs::temp_directory_path() / "heic_demo_predictor";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--workdir" && i + 1 < argc) workdir = argv[++i];
+        else {
+            std::cerr << "Usage: quality_predictor_test [--workdir <dir>]\n";
+            return 2;
+        }
+    }
+    std::error_code ec;
+    fs::create_directories(workdir, ec);
+
+    check_block_variance(64, 64);     // whole blocks
+    check_block_variance(45, 37);     // partial border blocks are not counted
+    check_block_variance(7, 30);      // no complete block
+    check_fit();
+    check_save_load(workdir);
+    check_sweep_csv(workdir);
+    check_failure_sentinel(workdir);
+
+    if (g_failures == 0) std::cout << "(PREDICTOR) All checks passed\n";
+    return g_failures == 0 ? 0 : 1;
+}
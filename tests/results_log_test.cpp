@@ -0,0 +1,276 @@
+// results_log_test.cpp – resume and torn-tail recovery of ResultsLog
+//
+// For both formats (CSV and columnar .rlog): writes a log in several batches,
+// appends garbage as an interrupted write would leave it, reopens the log and
+// checks that the garbage is cut off, resumedRows() / contains() report the
+// intact rows and new rows are appended behind them. A log truncated in the
+// middle of its last row / batch must lose exactly that row / batch. A
+// corrupt batch header (row count) or an unparsable CSV line in the middle
+// must not cost the rows around it, and "./a.png" / "/abs/a.png" are one image.
+//
+// Usage:
+//   results_log_test [--workdir <dir>]
+
+#include "results_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "(RESULTS LOG) FAILED: " << what << '\n';
+        ++g_failures;
+    }
+}
+
+static std::vector<ResultsRow> make_rows(size_t first, size_t count)
+{
+    std::vector<ResultsRow> rows;
+    for (size_t i = first; i < first + count; ++i) {
+        ResultsRow r;
+        // Separators and quotes in the path exercise CSV quoting
+        r.image = i % 3 == 0 ? "corpus/img \"" + std::to_string(i) + "\", copy.png"
+                             : "corpus/img" + std::to_string(i) + ".png";
+        r.codec = i % 2 ? "heic" : "jpeg";
+        r.quality = int(i * 5 % 101);
+        r.psnr = i == 4 ? INFINITY : 20.0 + 0.25 * double(i);   // lossless point as "inf"
+        r.size_bytes = 1000 + 37 * uint64_t(i);
+        rows.push_back(r);
+    }
+    return rows;
+}
+
+static bool same_row(const ResultsRow& a, const ResultsRow& b)
+{
+    const bool psnr_ok = (std::isinf(a.psnr) && std::isinf(b.psnr)) || std::abs(a.psnr - b.psnr) < 1e-6;
+    return a.image == b.image && a.codec == b.codec && a.quality == b.quality && psnr_ok &&
+           a.size_bytes == b.size_bytes;
+}
+
+static void check_contents(const std::string& path, ResultsFormat format,
+                           const std::vector<ResultsRow>& expected, const std::string& what)
+{
+    std::vector<ResultsRow> rows;
+    check(ResultsLog::readAll(path, format, rows), what + ": readAll");
+    check(rows.size() == expected.size(),
+          what + ": " + std::to_string(rows.size()) + " rows, expected " + std::to_string(expected.size()));
+    for (size_t i = 0; i < std::min(rows.size(), expected.size()); ++i)
+        check(same_row(rows[i], expected[i]), what + ": row " + std::to_string(i) + " differs");
+}
+
+static void append_bytes(const std::string& path, const std::string& bytes)
+{
+    std::ofstream(path, std::ios::binary | std::ios::app).write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+static void run(const fs::path& workdir, const std::string& file, ResultsFormat format)
+{
+    const std::string path = (workdir / file).string();
+    const std::string name = file + ": ";
+    std::error_code ec;
+    fs::remove(path, ec);
+
+    // ---- 1. Fresh log, 7 rows in batches of 3 -----------------------------
+    std::vector<ResultsRow> expected = make_rows(0, 7);
+    {
+        ResultsLog log(path, format, {3, 1});
+        check(log.resumedRows() == 0, name + "fresh log resumed rows");
+        for (const ResultsRow& r : expected) log.append(r);
+        check(log.contains(expected[5].image, expected[5].codec, expected[5].quality), name + "contains own row");
+    }
+    check_contents(path, format, expected, name + "after first run");
+    const uintmax_t intact_size = fs::file_size(path);
+
+    // ---- 2. Torn tail: an interrupted row / batch write ---------------------
+    if (format == ResultsFormat::CSV) {
+        append_bytes(path, "corpus/torn.png,heic,4");
+    } else {
+        std::vector<uint8_t> torn;
+        results_log_detail::put(torn, uint32_t(2));       // rows
+        results_log_detail::put(torn, uint32_t(64));      // payload bytes, only a few follow
+        results_log_detail::put(torn, uint32_t(0xDEADBEEF));
+        torn.insert(torn.end(), {1, 2, 3, 4, 5, 6, 7, 8, 9});
+        append_bytes(path, std::string(torn.begin(), torn.end()));
+    }
+    check(fs::file_size(path) > intact_size, name + "garbage appended");
+
+    // ---- 3. Resume: garbage cut off, old rows known, new rows appended ------
+    const std::vector<ResultsRow> more = make_rows(7, 2);
+    {
+        ResultsLog log(path, format, {3, 1});
+        check(log.resumedRows() == expected.size(),
+              name + "resumed " + std::to_string(log.resumedRows()) + " rows, expected " + std::to_string(expected.size()));
+        check(fs::file_size(path) == intact_size, name + "torn tail truncated");
+        for (const ResultsRow& r : expected)
+            check(log.contains(r.image, r.codec, r.quality), name + "resumed row missing from contains()");
+        check(!log.contains("corpus/torn.png", "heic", 4), name + "torn row reported by contains()");
+        check(!log.contains(more[0].image, more[0].codec, more[0].quality), name + "unwritten row reported");
+        for (const ResultsRow& r : more) log.append(r);
+        check(log.writtenRows() == 0, name + "rows written before the batch was full");
+    }
+    expected.insert(expected.end(), more.begin(), more.end());
+    check_contents(path, format, expected, name + "after resume");
+
+    // ---- 4. Log cut inside its last row / batch ----------------------------
+    // The two rows of the resumed run form the last CSV lines / one batch
+    fs::resize_file(path, fs::file_size(path) - 5, ec);
+    check(!ec, name + "truncate");
+    expected.resize(format == ResultsFormat::CSV ? expected.size() - 1 : expected.size() - more.size());
+    {
+        ResultsLog log(path, format, {3, 1});
+        check(log.resumedRows() == expected.size(),
+              name + "after truncation resumed " + std::to_string(log.resumedRows()) + " rows, expected " +
+                  std::to_string(expected.size()));
+    }
+    check_contents(path, format, expected, name + "after truncation");
+
+    // ---- 5. Not a log at all: refused, file left alone --------------------
+    const std::string foreign = (workdir / ("foreign_" + file)).string();
+    const std::string sweep_csv = "quality,psnr,size_bytes\n50,40.0,1234\n";
+    std::ofstream(foreign, std::ios::trunc) << sweep_csv;
+    bool refused = false;
+    try {
+        ResultsLog log(foreign, format);
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    check(refused, name + "foreign file accepted");
+    check(fs::file_size(foreign) == sweep_csv.size(), name + "foreign file modified");
+}
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+}
+
+// Columnar: the row count is covered by the CRC and bounded by the payload
+static void check_batch_header(const fs::path& workdir)
+{
+    const std::string path = (workdir / "header.rlog").string();
+    std::error_code ec;
+    fs::remove(path, ec);
+    const std::vector<ResultsRow> rows = make_rows(0, 6);
+    {
+        ResultsLog log(path, ResultsFormat::Columnar, {3, 1});
+        for (const ResultsRow& r : rows) log.append(r);
+    }
+    const std::vector<uint8_t> bytes = read_file(path);
+    check(bytes.size() > 8 && bytes[4] == 3 && bytes[5] == 0 && bytes[6] == 0 && bytes[7] == 0,
+          "rlog: row count not little endian");
+
+    // Second batch starts behind the first: 4 magic + 8 header + payload + 4 CRC
+    const uint32_t payload = bytes[8] | uint32_t(bytes[9]) << 8 | uint32_t(bytes[10]) << 16 | uint32_t(bytes[11]) << 24;
+    const size_t second = 4 + 8 + payload + 4;
+    check(second < bytes.size(), "rlog: second batch offset");
+
+    auto rows_after = [&](std::vector<uint8_t> corrupt) {
+        write_file(path, corrupt);
+        std::vector<ResultsRow> back;
+        ResultsLog::readAll(path, ResultsFormat::Columnar, back);
+        return back.size();
+    };
+    std::vector<uint8_t> c = bytes;
+    c[4] = 2;                                           // 3 -> 2 rows, same payload
+    check(rows_after(c) == 0, "rlog: changed row count not caught by the CRC");
+    c = bytes;
+    c[second + 3] = 0x7F;                               // ~2e9 rows in the second batch
+    check(rows_after(c) == 3, "rlog: huge row count in the last batch not dropped alone");
+    c = bytes;
+    c[4] = 0xFF; c[5] = 0xFF; c[6] = 0xFF; c[7] = 0xFF; // 4e9 rows
+    check(rows_after(c) == 0, "rlog: huge row count accepted");
+}
+
+// CSV: an unparsable line in the middle is skipped, not fatal
+static void check_bad_csv_line(const fs::path& workdir)
+{
+    const std::string path = (workdir / "bad_line.csv").string();
+    std::error_code ec;
+    fs::remove(path, ec);
+    std::vector<ResultsRow> rows = make_rows(0, 2);
+    {
+        ResultsLog log(path, ResultsFormat::CSV, {1, 1});
+        for (const ResultsRow& r : rows) log.append(r);
+    }
+    append_bytes(path, "corpus/bad.png,jpeg,not a number,1.0,1\n");
+    const std::vector<ResultsRow> more = make_rows(2, 2);
+    {
+        ResultsLog log(path, ResultsFormat::CSV, {1, 1});
+        for (const ResultsRow& r : more) log.append(r);
+    }
+    const uintmax_t size = fs::file_size(path);
+    rows.insert(rows.end(), more.begin(), more.end());
+    try {
+        ResultsLog log(path, ResultsFormat::CSV);
+        check(log.resumedRows() == rows.size(), "csv: rows around a bad line lost");
+        check(log.skippedLines() == 1, "csv: bad line not counted");
+    } catch (const std::runtime_error&) {
+        check(false, "csv: log with a bad line refused");
+    }
+    check(fs::file_size(path) == size, "csv: log with a bad line truncated");
+    check_contents(path, ResultsFormat::CSV, rows, "csv with a bad line");
+}
+
+// Resume keys: one image under different spellings of its path
+static void check_path_keys(const fs::path& workdir)
+{
+    const std::string path = (workdir / "keys.csv").string();
+    std::error_code ec;
+    fs::remove(path, ec);
+    const std::string relative = "corpus/a.png";
+    const std::string absolute = (fs::current_path() / "corpus" / "x" / ".." / "a.png").string();
+    {
+        ResultsLog log(path, ResultsFormat::CSV);
+        log.append({"./" + relative, "jpeg", 50, 40.0, 1000});
+        check(log.contains(absolute, "jpeg", 50), "keys: absolute path not matched");
+    }
+    ResultsLog log(path, ResultsFormat::CSV);
+    check(log.contains(relative, "jpeg", 50) && log.contains(absolute, "jpeg", 50), "keys: resumed path not matched");
+    check(!log.contains("corpus/b.png", "jpeg", 50), "keys: other image matched");
+}
+
+int main(int argc, char** argv)
+{
+    fs::path workdir = fs::temp_directory_path() / "heic_demo_results_log";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--workdir" && i + 1 < argc) workdir = argv[++i];
+        else {
+            std::cerr << "Usage: results_log_test [--workdir <dir>]\n";
+            return 2;
+        }
+    }
+    std::error_code ec;
+    fs::create_directories(workdir, ec);
+
+    try {
+        run(workdir, "results.csv", ResultsFormat::CSV);
+        run(workdir, "results.rlog", ResultsFormat::Columnar);
+        check_batch_header(workdir);
+        check_bad_csv_line(workdir);
+        check_path_keys(workdir);
+    } catch (const std::exception& e) {
+        check(false, std::string("unexpected exception: ") + e.what());
+    }
+
+    if (g_failures == 0) std::cout << "(RESULTS LOG) All checks passed\n";
+    return g_failures == 0 ? 0 : 1;
+}
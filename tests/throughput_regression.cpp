@@ -0,0 +1,515 @@
+// throughput_regression.cpp – end-to-end sweep regression test against stored baselines
+//
+// Generates a deterministic synthetic corpus, runs the JPEG (tjCompress2 and
+// DCT-once) and HEIC quality sweeps on it and compares output bytes and PSNR
+// against the baseline CSV. Any value outside its tolerance is reported in a
+// diff table and makes the test fail. Without a baseline nothing can be
+// compared; the test then exits with kSkipped (CTest reports it as skipped)
+// and tells how to record one.
+//
+// images/s depends on the machine, so it is kept in a separate speed baseline
+// (normally inside the build directory) and only checked with --check-speed.
+// --speed-only compares images/s alone, which CTest runs as its own test.
+// Builds with HEIC_DEMO_X265_ANALYSIS_REUSE also run the analysis-reuse sweep
+// against independent encodes: it must stay within kReusePsnrTol /
+// kReuseSizeTolPct and, when speed is checked, be faster.
+//
+// Usage:
+//   throughput_regression --baseline <csv> [--speed-baseline <csv>] [--workdir <dir>]
+//                         [--update] [--check-speed] [--speed-only] [--psnr-tol dB]
+//                         [--size-tol frac] [--speed-tol frac] [--skip-heic]
+
+#include "heic.h"
+#include "jpg.h"
+#include "jpg_sweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Largest deviation of the analysis-reuse sweep from independent encodes
+static constexpr double kReusePsnrTol = 0.3;     // dB
+static constexpr double kReuseSizeTolPct = 3.0;  // %
+
+// Exit code for "nothing to compare against", SKIP_RETURN_CODE in CMakeLists.txt
+static constexpr int kSkipped = 77;
+
+// ----------------------------------------------------------------------------
+// Synthetic corpus
+// Every image is generated from closed formulas and a fixed-seed LCG so the
+// pixels are bit-identical on every platform.
+// ----------------------------------------------------------------------------
+struct SyntheticImage {
+    std::string name;
+    int width;
+    int height;
+    int channels;                   // 3 = RGB, 4 = RGBA
+    std::vector<unsigned char> px;
+};
+
+static uint32_t lcg_next(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static SyntheticImage make_gradient(int w, int h)
+{
+    SyntheticImage img{"gradient", w, h, 3, std::vector<unsigned char>(size_t(w) * h * 3)};
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            unsigned char* p = &img.px[(size_t(y) * w + x) * 3];
+            p[0] = static_cast<unsigned char>(255 * x / (w - 1));
+            p[1] = static_cast<unsigned char>(255 * y / (h - 1));
+            p[2] = static_cast<unsigned char>(255 * (x + y) / (w + h - 2));
+        }
+    return img;
+}
+
+// Hard edges: stripes, a checkerboard and a block of "glyphs"
+static SyntheticImage make_edges(int w, int h)
+{
+    SyntheticImage img{"edges", w, h, 3, std::vector<unsigned char>(size_t(w) * h * 3)};
+    uint32_t seed = 0xC0FFEEu;
+    std::vector<uint32_t> glyphs(64);
+    for (uint32_t& g : glyphs) g = lcg_next(seed);
+
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            unsigned char* p = &img.px[(size_t(y) * w + x) * 3];
+            unsigned char v;
+            if (y < h / 3)
+                v = ((x / 3) % 2) ? 255 : 0;                              // stripes
+            else if (y < 2 * h / 3)
+                v = (((x / 16) + (y / 16)) % 2) ? 230 : 20;               // checkerboard
+            else {
+                const uint32_t g = glyphs[((y / 8) * 8 + (x / 6)) % glyphs.size()];
+                v = ((g >> ((y % 8) * 3 + (x % 6) / 2)) & 1u) ? 0 : 255;  // "text"
+            }
+            p[0] = v;
+            p[1] = v;
+            p[2] = static_cast<unsigned char>(255 - v / 2);
+        }
+    return img;
+}
+
+static SyntheticImage make_noise(int w, int h)
+{
+    SyntheticImage img{"noise", w, h, 3, std::vector<unsigned char>(size_t(w) * h * 3)};
+    uint32_t seed = 12345u;
+    for (unsigned char& c : img.px)
+        c = static_cast<unsigned char>(64 + lcg_next(seed) % 128);
+    return img;
+}
+
+// RGBA with a transparent disc, exercises the JPEG alpha mask
+static SyntheticImage make_alpha(int w, int h)
+{
+    SyntheticImage img{"alpha", w, h, 4, std::vector<unsigned char>(size_t(w) * h * 4)};
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            unsigned char* p = &img.px[(size_t(y) * w + x) * 4];
+            const int dx = x - w / 2, dy = y - h / 2;
+            p[0] = static_cast<unsigned char>((x * 5) & 0xFF);
+            p[1] = static_cast<unsigned char>((y * 3) & 0xFF);
+            p[2] = 128;
+            p[3] = (dx * dx + dy * dy < (h / 3) * (h / 3)) ? 0 : 255;
+        }
+    return img;
+}
+
+// Dimensions are kept at multiples of 16: with other sizes the padded border
+// libheif hands to x265 is not initialised and HEIC output varies run to run.
+static std::vector<SyntheticImage> make_corpus()
+{
+    return {make_gradient(320, 240), make_edges(320, 240), make_noise(256, 256), make_alpha(192, 128)};
+}
+
+// ----------------------------------------------------------------------------
+// Measurements
+// One row per (codec, image, quality, metric). Throughput rows use image "*"
+// and quality -1.
+// ----------------------------------------------------------------------------
+using MetricKey = std::tuple<std::string, std::string, int, std::string>; // codec, image, quality, metric
+using MetricMap = std::map<MetricKey, double>;
+
+static bool read_sweep_csv(const fs::path& csv_path, const std::string& codec,
+                           const std::string& image, MetricMap& out)
+{
+    std::ifstream in(csv_path);
+    if (!in) return false;
+
+    std::string line;
+    std::getline(in, line); // header: quality,psnr,size_bytes
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        std::istringstream ss(line);
+        std::string q, psnr, bytes;
+        std::getline(ss, q, ',');
+        std::getline(ss, psnr, ',');
+        std::getline(ss, bytes, ',');
+        const int quality = std::stoi(q);
+        out[{codec, image, quality, "psnr"}] = std::stod(psnr);
+        out[{codec, image, quality, "size_bytes"}] = std::stod(bytes);
+    }
+    return true;
+}
+
+static bool read_baseline(const fs::path& path, MetricMap& out)
+{
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#' || line.rfind("codec,", 0) == 0) continue;
+        std::istringstream ss(line);
+        std::string codec, image, q, metric, value;
+        std::getline(ss, codec, ',');
+        std::getline(ss, image, ',');
+        std::getline(ss, q, ',');
+        std::getline(ss, metric, ',');
+        std::getline(ss, value, ',');
+        out[{codec, image, std::stoi(q), metric}] = std::stod(value);
+    }
+    return true;
+}
+
+static bool is_speed_metric(const MetricKey& key)
+{
+    return std::get<3>(key) == "images_per_s";
+}
+
+// Rows of values whose metric is (speed == true) or is not (speed == false) images/s
+static MetricMap select_metrics(const MetricMap& values, bool speed)
+{
+    MetricMap out;
+    for (const auto& [key, value] : values)
+        if (is_speed_metric(key) == speed) out.emplace(key, value);
+    return out;
+}
+
+static bool write_baseline(const fs::path& path, const MetricMap& values)
+{
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+
+    out << "# Generated by throughput_regression --update.\n";
+    out << "codec,image,quality,metric,value\n";
+    out << std::fixed << std::setprecision(4);
+    for (const auto& [key, value] : values) {
+        const auto& [codec, image, quality, metric] = key;
+        out << codec << ',' << image << ',' << quality << ',' << metric << ',' << value << '\n';
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Comparison
+// ----------------------------------------------------------------------------
+struct Tolerances {
+    double psnr_db = 0.05;     // absolute, dB
+    double size_frac = 0.01;   // relative
+    double speed_frac = 0.35;  // relative slowdown that still passes
+    bool check_speed = false;  // opt-in, images/s is only comparable on one machine
+};
+
+static int compare(const MetricMap& baseline, const MetricMap& current, const Tolerances& tol)
+{
+    int failures = 0;
+    std::ostringstream diff;
+    diff << std::fixed << std::setprecision(4);
+
+    for (const auto& [key, base] : baseline) {
+        const auto& [codec, image, quality, metric] = key;
+        const auto it = current.find(key);
+        if (it == current.end()) {
+            diff << "  " << std::left << std::setw(6) << codec << std::setw(10) << image
+                 << " q" << std::setw(4) << quality << std::setw(14) << metric
+                 << "missing from current run\n";
+            ++failures;
+            continue;
+        }
+
+        const double cur = it->second;
+        bool ok = true;
+        std::string limit;
+        if (metric == "psnr") {
+            // INFINITY (lossless) is written as "inf" and compares equal to itself
+            ok = (std::isinf(base) && std::isinf(cur)) || std::abs(cur - base) <= tol.psnr_db;
+            limit = "±" + std::to_string(tol.psnr_db) + " dB";
+        } else if (metric == "size_bytes") {
+            ok = std::abs(cur - base) <= tol.size_frac * base;
+            limit = "±" + std::to_string(tol.size_frac * 100.0) + " %";
+        } else if (metric == "images_per_s") {
+            ok = cur >= base * (1.0 - tol.speed_frac);
+            limit = ">= -" + std::to_string(tol.speed_frac * 100.0) + " %";
+        }
+
+        if (!ok) {
+            diff << "  " << std::left << std::setw(6) << codec << std::setw(10) << image
+                 << " q" << std::setw(4) << quality << std::setw(14) << metric
+                 << std::right << std::setw(14) << base << " -> " << std::setw(14) << cur
+                 << "  (delta " << std::showpos << (cur - base) << std::noshowpos
+                 << ", limit " << limit << ")\n";
+            ++failures;
+        }
+    }
+
+    for (const auto& [key, value] : current) {
+        if (baseline.count(key)) continue;
+        const auto& [codec, image, quality, metric] = key;
+        diff << "  " << std::left << std::setw(6) << codec << std::setw(10) << image
+             << " q" << std::setw(4) << quality << std::setw(14) << metric
+             << "not in baseline (value " << value << ")\n";
+        ++failures;
+    }
+
+    if (failures) {
+        std::cerr << "(REGRESSION) " << failures << " value(s) outside tolerance:\n"
+                  << "  codec image      q   metric              baseline ->        current\n"
+                  << diff.str();
+    }
+    return failures;
+}
+
+// ----------------------------------------------------------------------------
+// Runner
+// ----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    fs::path baseline_path;
+    fs::path speed_baseline_path;
+    fs::path workdir = fs::temp_directory_path() / "heic_demo_regression";
+    bool update = false;
+    bool speed_only = false;
+    bool skip_heic = false;
+    Tolerances tol;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << '\n';
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--baseline")            baseline_path = next();
+        else if (arg == "--speed-baseline") speed_baseline_path = next();
+        else if (arg == "--workdir")        workdir = next();
+        else if (arg == "--update")         update = true;
+        else if (arg == "--check-speed")    tol.check_speed = true;
+        else if (arg == "--speed-only")     speed_only = tol.check_speed = true;
+        else if (arg == "--psnr-tol")       tol.psnr_db = std::stod(next());
+        else if (arg == "--size-tol")       tol.size_frac = std::stod(next());
+        else if (arg == "--speed-tol")      tol.speed_frac = std::stod(next());
+        else if (arg == "--skip-heic")      skip_heic = true;
+        else {
+            std::cerr << "Unknown argument " << arg << '\n';
+            return 2;
+        }
+    }
+    if ((baseline_path.empty() && !speed_only) || (tol.check_speed && speed_baseline_path.empty()) ||
+        (update && (baseline_path.empty() || speed_only))) {
+        std::cerr << "Usage: throughput_regression --baseline <csv> [--speed-baseline <csv>] [--update] ...\n";
+        return 2;
+    }
+
+    if (!baseline_path.empty()) baseline_path = fs::absolute(baseline_path);
+    if (!speed_baseline_path.empty()) speed_baseline_path = fs::absolute(speed_baseline_path);
+    workdir = fs::absolute(workdir);
+
+    // Never record silently: a test that writes its own expectation compares
+    // nothing. Read the baselines first so a skip costs no sweep.
+    MetricMap baseline, measured;
+    if (!update && !speed_only) {
+        if (!read_baseline(baseline_path, baseline)) {
+            std::cerr << "(REGRESSION) No baseline at " << baseline_path << ", skipped.\n"
+                      << "Record one with: cmake --build <build dir> --target update_throughput_baseline\n";
+            return kSkipped;
+        }
+        baseline = select_metrics(baseline, false);
+    }
+    if (!update && tol.check_speed) {
+        MetricMap speed;
+        if (!read_baseline(speed_baseline_path, speed)) {
+            std::cerr << "(REGRESSION) No speed baseline at " << speed_baseline_path << ", skipped.\n"
+                      << "Record one with: cmake --build <build dir> --target update_throughput_baseline\n";
+            return kSkipped;
+        }
+        for (const auto& [key, value] : select_metrics(speed, true)) baseline[key] = value;
+    }
+
+    std::error_code ec;
+    fs::create_directories(workdir, ec);
+    // JpegPSNRtoCSV places its temporaries in the working directory
+    fs::current_path(workdir, ec);
+
+    // ---- 1. Write corpus ---------------------------------------------------
+    const std::vector<SyntheticImage> corpus = make_corpus();
+    std::vector<fs::path> paths;
+    for (const SyntheticImage& img : corpus) {
+        const fs::path p = workdir / (img.name + ".png");
+        if (!stbi_write_png(p.string().c_str(), img.width, img.height, img.channels,
+                            img.px.data(), img.width * img.channels)) {
+            std::cerr << "Could not write corpus image " << p << '\n';
+            return 2;
+        }
+        paths.push_back(p);
+    }
+
+    // ---- 2. Run sweeps -----------------------------------------------------
+    MetricMap current;
+    int reuse_failures = 0;
+    using clock = std::chrono::steady_clock;
+
+    double jpeg_seconds = 0.0;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        const fs::path csv = workdir / (corpus[i].name + "_jpeg.csv");
+        const auto t0 = clock::now();
+        JpegPSNRtoCSV(paths[i].string(), csv.string(), false);
+        jpeg_seconds += std::chrono::duration<double>(clock::now() - t0).count();
+        if (!read_sweep_csv(csv, "jpeg", corpus[i].name, current)) {
+            std::cerr << "Could not read " << csv << '\n';
+            return 2;
+        }
+    }
+    current[{"jpeg", "*", -1, "images_per_s"}] = corpus.size() / jpeg_seconds;
+
+    double jpegdct_seconds = 0.0;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        const fs::path csv = workdir / (corpus[i].name + "_jpegdct.csv");
+        const auto t0 = clock::now();
+        JpegDctOncePSNRtoCSV(paths[i].string(), csv.string(), false);
+        jpegdct_seconds += std::chrono::duration<double>(clock::now() - t0).count();
+        if (!read_sweep_csv(csv, "jpegdct", corpus[i].name, current)) {
+            std::cerr << "Could not read " << csv << '\n';
+            return 2;
+        }
+    }
+    current[{"jpegdct", "*", -1, "images_per_s"}] = corpus.size() / jpegdct_seconds;
+
+    if (!skip_heic) {
+        double heic_seconds = 0.0;
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            const fs::path csv = workdir / (corpus[i].name + "_heic.csv");
+            const auto t0 = clock::now();
+            const bool ok = evaluateHeicQualitySweep(paths[i].string(), csv.string(), false);
+            heic_seconds += std::chrono::duration<double>(clock::now() - t0).count();
+            if (!ok || !read_sweep_csv(csv, "heic", corpus[i].name, current)) {
+                std::cerr << "HEIC sweep failed for " << corpus[i].name << '\n';
+                return 2;
+            }
+        }
+        current[{"heic", "*", -1, "images_per_s"}] = corpus.size() / heic_seconds;
+
+        double heicshared_seconds = 0.0;
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            const fs::path csv = workdir / (corpus[i].name + "_heicshared.csv");
+            const auto t0 = clock::now();
+            const bool ok = evaluateHeicSharedSourceSweep(paths[i].string(), csv.string(), false);
+            heicshared_seconds += std::chrono::duration<double>(clock::now() - t0).count();
+            if (!ok || !read_sweep_csv(csv, "heicshared", corpus[i].name, current)) {
+                std::cerr << "Shared-source HEIC sweep failed for " << corpus[i].name << '\n';
+                return 2;
+            }
+        }
+        current[{"heicshared", "*", -1, "images_per_s"}] = corpus.size() / heicshared_seconds;
+
+        // Analysis reuse (HEIC_DEMO_X265_ANALYSIS_REUSE builds only): each sweep
+        // also runs the independent encodes of the same source, so reuse has
+        // to match them in PSNR and size and, with --check-speed, be faster
+        if (kHeicAnalysisReuseAvailable) {
+            HeicAnalysisReuse reuse;
+            reuse.enabled = true;
+            double heicreuse_seconds = 0.0, independent_seconds = 0.0;
+            double psnr_dev = 0.0, size_dev_pct = 0.0;
+            for (size_t i = 0; i < corpus.size(); ++i) {
+                const fs::path csv = workdir / (corpus[i].name + "_heicreuse.csv");
+                HeicSweepComparison cmp;
+                const bool ok = evaluateHeicSharedSourceSweep(paths[i].string(), csv.string(), false,
+                                                              {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100},
+                                                              true, {}, reuse, &cmp);
+                if (!ok || cmp.compared == 0 || !read_sweep_csv(csv, "heicreuse", corpus[i].name, current)) {
+                    std::cerr << "Analysis-reuse HEIC sweep failed for " << corpus[i].name << '\n';
+                    return 2;
+                }
+                heicreuse_seconds += cmp.shared_s;
+                independent_seconds += cmp.independent_s;
+                psnr_dev = std::max(psnr_dev, cmp.max_psnr_dev);
+                size_dev_pct = std::max(size_dev_pct, cmp.max_size_dev_pct);
+            }
+            current[{"heicreuse", "*", -1, "images_per_s"}] = corpus.size() / heicreuse_seconds;
+
+            const double speedup = independent_seconds / heicreuse_seconds;
+            std::cout << std::fixed << std::setprecision(2) << "(REGRESSION) heicreuse vs independent: max "
+                      << psnr_dev << " dB, max " << size_dev_pct << " % size, speedup " << speedup << "x\n";
+            if (!speed_only && (psnr_dev > kReusePsnrTol || size_dev_pct > kReuseSizeTolPct)) {
+                std::cerr << "(REGRESSION) Analysis reuse changes the result beyond " << kReusePsnrTol << " dB / "
+                          << kReuseSizeTolPct << " % size\n";
+                reuse_failures += 1;
+            }
+            if (tol.check_speed && speedup <= 1.0) {
+                std::cerr << "(REGRESSION) Analysis reuse is not faster than independent encodes\n";
+                reuse_failures += 1;
+            }
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "(REGRESSION) jpeg " << current[{"jpeg", "*", -1, "images_per_s"}] << " images/s"
+              << ", jpegdct " << current[{"jpegdct", "*", -1, "images_per_s"}] << " images/s";
+    if (!skip_heic)
+        std::cout << ", heic " << current[{"heic", "*", -1, "images_per_s"}] << " images/s"
+                  << ", heicshared " << current[{"heicshared", "*", -1, "images_per_s"}] << " images/s";
+    if (!skip_heic && kHeicAnalysisReuseAvailable)
+        std::cout << ", heicreuse " << current[{"heicreuse", "*", -1, "images_per_s"}] << " images/s";
+    std::cout << '\n';
+
+    // ---- 3. Compare or record ----------------------------------------------
+    if (update) {
+        if (!write_baseline(baseline_path, select_metrics(current, false))) {
+            std::cerr << "Could not write baseline " << baseline_path << '\n';
+            return 2;
+        }
+        std::cout << "(REGRESSION) Baseline updated: " << baseline_path << '\n';
+        if (!speed_baseline_path.empty()) {
+            if (!write_baseline(speed_baseline_path, select_metrics(current, true))) {
+                std::cerr << "Could not write speed baseline " << speed_baseline_path << '\n';
+                return 2;
+            }
+            std::cout << "(REGRESSION) Speed baseline updated: " << speed_baseline_path << '\n';
+        }
+        return 0;
+    }
+
+    measured = select_metrics(current, speed_only);
+    if (tol.check_speed && !speed_only)
+        for (const auto& [key, value] : select_metrics(current, true)) measured[key] = value;
+
+    if (skip_heic) {
+        for (auto it = baseline.begin(); it != baseline.end();)
+            it = std::get<0>(it->first).compare(0, 4, "heic") == 0 ? baseline.erase(it) : std::next(it);
+    }
+
+    const int failures = compare(baseline, measured, tol) + reuse_failures;
+    if (failures == 0)
+        std::cout << "(REGRESSION) All " << baseline.size() << " values within tolerance\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+// watch_daemon_test.cpp – BoundedQueue semantics and WatchDaemon shutdown / resume
+//
+// BoundedQueue: push() blocks at capacity until a pop() makes room, pop()
+// blocks on an empty queue until a push(), close() wakes blocked consumers,
+// items queued before close() are still delivered, then pop() returns false.
+//
+// WatchDaemon (jpeg-dct only, no HEIC encoder needed): stop() right after
+// start() still finishes and logs every image found at start; a file moved
+// into the directory while running is picked up; a.png and a.jpg get distinct
+// outputs; a restart on the same log encodes only the missing points and
+// never appends duplicate rows.
+//
+// Usage:
+//   watch_daemon_test [--workdir <dir>]
+
+#include "watch_daemon.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+static int g_failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "(WATCH) FAILED: " << what << '\n';
+        ++g_failures;
+    }
+}
+
+// Poll cond for up to timeout
+template <typename Cond>
+static bool eventually(Cond cond, std::chrono::milliseconds timeout = 10000ms)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(10ms);
+    }
+    return true;
+}
+
+// ---- BoundedQueue ------------------------------------------------------------
+static void check_queue_capacity()
+{
+    BoundedQueue<int> q(2);
+    check(q.capacity() == 2, "queue: capacity");
+    q.push(1);
+    q.push(2);
+
+    std::atomic<bool> pushed{false};
+    std::thread producer([&] {
+        q.push(3);                                    // blocks, the queue is full
+        pushed = true;
+    });
+    std::this_thread::sleep_for(100ms);
+    check(!pushed && q.size() == 2, "queue: push did not block at capacity");
+
+    int v = 0;
+    check(q.pop(v) && v == 1, "queue: FIFO order");
+    check(eventually([&] { return pushed.load(); }), "queue: blocked push not released by pop");
+    producer.join();
+    check(q.size() == 2, "queue: size after release");
+    check(q.pop(v) && v == 2 && q.pop(v) && v == 3, "queue: order after blocked push");
+
+    check(BoundedQueue<int>(0).capacity() == 1, "queue: capacity 0 not raised to 1");
+}
+
+static void check_queue_blocking_pop()
+{
+    BoundedQueue<int> q(4);
+    std::atomic<int> got{0};
+    std::thread consumer([&] {
+        int v = 0;
+        if (q.pop(v)) got = v;                        // blocks, the queue is empty
+    });
+    std::this_thread::sleep_for(100ms);
+    check(got == 0, "queue: pop did not block on an empty queue");
+    q.push(42);
+    consumer.join();
+    check(got == 42, "queue: blocked pop did not get the pushed item");
+}
+
+static void check_queue_close()
+{
+    // close() wakes a consumer blocked on an empty queue
+    BoundedQueue<int> empty(4);
+    std::atomic<bool> returned{false}, result{true};
+    std::thread consumer([&] {
+        int v = 0;
+        result = empty.pop(v);
+        returned = true;
+    });
+    std::this_thread::sleep_for(50ms);
+    check(!returned, "queue: pop returned before close");
+    empty.close();
+    consumer.join();
+    check(returned && !result, "queue: close did not end a blocked pop with false");
+
+    // Items queued before close() are still delivered
+    BoundedQueue<int> q(4);
+    q.push(1);
+    q.push(2);
+    q.close();
+    int v = 0;
+    check(q.pop(v) && v == 1 && q.pop(v) && v == 2, "queue: items lost by close");
+    check(!q.pop(v), "queue: pop after drain of a closed queue");
+}
+
+// ---- WatchDaemon ---------------------------------------------------------------
+// PNG, or a JPEG made from it by JpgEncoder for a .jpg path
+static bool write_image(const fs::path& path, int seed)
+{
+    const int w = 48, h = 32;
+    std::vector<unsigned char> px(size_t(w) * h * 3);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            for (int c = 0; c < 3; ++c)
+                px[(size_t(y) * w + x) * 3 + c] = static_cast<unsigned char>((x * 5 + y * 3 + c * 40 + seed * 17) & 0xFF);
+    fs::path png = path;
+    if (path.extension() == ".jpg") png += ".png";
+    if (!stbi_write_png(png.string().c_str(), w, h, 3, px.data(), w * 3)) return false;
+    if (png == path) return true;
+    const std::string in = png.string(), out = path.string();   // JpgEncoder keeps the pointers
+    try {
+        JpgEncoder enc(in.c_str(), out.c_str());
+        if (!enc.jpeg_compress(95)) return false;
+    } catch (...) {
+        return false;
+    }
+    std::error_code ec;
+    fs::remove(png, ec);
+    return true;
+}
+
+static size_t log_rows(const std::string& log)
+{
+    std::vector<ResultsRow> rows;
+    ResultsLog::readAll(log, ResultsLog::formatForPath(log), rows);
+    return rows.size();
+}
+
+static WatchOptions options(const fs::path& workdir, std::vector<int> qualities)
+{
+    WatchOptions o;
+    o.watch_dir = (workdir / "in").string();
+    o.output_dir = (workdir / "out").string();
+    o.log_path = (workdir / "log.csv").string();
+    o.codecs = {"jpeg-dct"};
+    o.qualities = std::move(qualities);
+    o.queue_capacity = 2;
+    o.encode_threads = 2;
+    o.poll_ms = 50;
+    return o;
+}
+
+static void check_daemon(const fs::path& workdir)
+{
+    std::error_code ec;
+    fs::remove_all(workdir, ec);
+    fs::create_directories(workdir / "in");
+    check(write_image(workdir / "in" / "a.png", 1) && write_image(workdir / "in" / "a.jpg", 2) &&
+              write_image(workdir / "in" / "b.png", 3),
+          "daemon: write test images");
+    const std::string log = (workdir / "log.csv").string();
+
+    // 1. stop() right after start(): everything found at start is finished
+    {
+        WatchDaemon daemon(options(workdir, {50, 80}));
+        check(daemon.start(), "daemon: start");
+        daemon.stop();
+        daemon.wait();
+        const WatchStats s = daemon.stats();
+        check(s.rows_written == 6, "daemon: " + std::to_string(s.rows_written) + " rows after stop, expected 6");
+        for (size_t d : s.depth) check(d == 0, "daemon: queue not drained after wait");
+    }
+    check(log_rows(log) == 6, "daemon: log rows after first run");
+    for (const char* name : {"a_png_q50.jpg", "a_jpg_q50.jpg", "b_png_q80.jpg"})
+        check(fs::exists(workdir / "out" / name), std::string("daemon: missing output ") + name);
+
+    // 2. Restart with one more quality: only the missing points are encoded,
+    //    and a file moved in while running is picked up
+    {
+        WatchDaemon daemon(options(workdir, {50, 80, 90}));
+        check(daemon.start(), "daemon: restart");
+        check(eventually([&] { return daemon.stats().rows_written == 3; }), "daemon: missing points not encoded");
+
+        check(write_image(workdir / "c.png", 4), "daemon: write new image");
+        fs::rename(workdir / "c.png", workdir / "in" / "c.png", ec);
+        check(eventually([&] { return daemon.stats().rows_written == 6; }), "daemon: new image not picked up");
+
+        daemon.stop();
+        daemon.wait();
+        const WatchStats s = daemon.stats();
+        check(s.rows_written == 6, "daemon: " + std::to_string(s.rows_written) + " rows on restart, expected 6");
+        check(s.skipped == 6, "daemon: " + std::to_string(s.skipped) + " points skipped, expected 6");
+    }
+    check(log_rows(log) == 12, "daemon: " + std::to_string(log_rows(log)) + " log rows after restart, expected 12");
+
+    // 3. Everything logged: nothing is decoded, encoded or appended again
+    {
+        WatchDaemon daemon(options(workdir, {50, 80, 90}));
+        check(daemon.start(), "daemon: third start");
+        daemon.stop();
+        daemon.wait();
+        const WatchStats s = daemon.stats();
+        check(s.rows_written == 0 && s.encodes == 0, "daemon: logged points encoded again");
+    }
+    check(log_rows(log) == 12, "daemon: duplicate rows appended");
+}
+
+int main(int argc, char** argv)
+{
+    fs::path workdir = fs::temp_directory_path() / "heic_demo_watch";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--workdir" && i + 1 < argc) workdir = argv[++i];
+        else {
+            std::cerr << "Usage: watch_daemon_test [--workdir <dir>]\n";
+            return 2;
+        }
+    }
+
+    check_queue_capacity();
+    check_queue_blocking_pop();
+    check_queue_close();
+    try {
+        check_daemon(workdir);
+    } catch (const std::exception& e) {
+        check(false, std::string("unexpected exception: ") + e.what());
+    }
+
+    if (g_failures == 0) std::cout << "(WATCH) All checks passed\n";
+    return g_failures == 0 ? 0 : 1;
+}